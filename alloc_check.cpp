@@ -0,0 +1,263 @@
+/***************************************************************************
+*    Copyright (c) 2019-2021, Broadcom Inc.
+*
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions are
+*  met:
+*
+*  1. Redistributions of source code must retain the above copyright notice,
+*     this list of conditions and the following disclaimer.
+*
+*  2. Redistributions in binary form must reproduce the above copyright
+*     notice, this list of conditions and the following disclaimer in the
+*     documentation and/or other materials provided with the distribution.
+*
+*  3. Neither the name of the copyright holder nor the names of its
+*     contributors may be used to endorse or promote products derived from
+*     this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+*  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+*  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+*  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+*  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+*  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+*  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+*  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+*  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+*  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+*  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***************************************************************************/
+
+/** @file alloc_check.cpp
+	@brief Defines the entry point for the alloc_check application.
+
+	This file provides a check that reading and writing rows performs no heap allocation once the first row of an
+	image element has been processed. Each input file is decoded, then re-encoded both uncompressed and with RLE, while
+	a replaced global operator new counts allocations.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "hdr_dpx.h"
+#include <iostream>
+#include <new>
+#include <vector>
+#include <string>
+
+using namespace std;
+
+/** Number of heap allocations made through operator new since the program started */
+static unsigned long g_num_allocations = 0;
+
+void *operator new(size_t size)
+{
+	g_num_allocations++;
+	void *ptr = malloc(size ? size : 1);
+	if (ptr == NULL)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	free(ptr);
+}
+
+
+/** Application row buffers large enough for one row of an image element in any of the supported sample types */
+struct RowBuffers
+{
+	std::vector<int32_t> int_row;   ///< Row for integer samples
+	std::vector<float> float_row;   ///< Row for 32-bit floating point samples
+	std::vector<double> double_row;   ///< Row for 64-bit floating point samples
+};
+
+
+/**
+	Reads one row of an image element in the sample type that matches its bit depth
+
+	@param ie			Image element to read
+	@param row			Row number
+	@param buffers		Row buffers to read into
+*/
+static void read_row(Dpx::HdrDpxImageElement *ie, uint32_t row, RowBuffers &buffers)
+{
+	Dpx::HdrDpxBitDepth bit_depth = ie->GetHeader(Dpx::eBitDepth);
+
+	if (bit_depth == Dpx::eBitDepthR32)
+		ie->Dpx2AppPixels(row, buffers.float_row.data());
+	else if (bit_depth == Dpx::eBitDepthR64)
+		ie->Dpx2AppPixels(row, buffers.double_row.data());
+	else
+		ie->Dpx2AppPixels(row, buffers.int_row.data());
+}
+
+
+/**
+	Writes one row of an image element in the sample type that matches its bit depth
+
+	@param ie			Image element to write
+	@param row			Row number
+	@param buffers		Row buffers to write from
+*/
+static void write_row(Dpx::HdrDpxImageElement *ie, uint32_t row, RowBuffers &buffers)
+{
+	Dpx::HdrDpxBitDepth bit_depth = ie->GetHeader(Dpx::eBitDepth);
+
+	if (bit_depth == Dpx::eBitDepthR32)
+		ie->App2DpxPixels(row, buffers.float_row.data());
+	else if (bit_depth == Dpx::eBitDepthR64)
+		ie->App2DpxPixels(row, buffers.double_row.data());
+	else
+		ie->App2DpxPixels(row, buffers.int_row.data());
+}
+
+
+/**
+	Decodes a DPX file and re-encodes it uncompressed and with RLE, counting the allocations made for every row after the
+	first of each image element
+
+	@param in_name		DPX file to check
+	@param out_name		Scratch file written while encoding
+	@return				true if no steady-state allocation was seen
+*/
+static bool check_file(const std::string &in_name, const std::string &out_name)
+{
+	Dpx::HdrDpxFile in_file(in_name);
+	std::vector<uint8_t> ie_list = in_file.GetIEIndexList();
+	std::vector<RowBuffers> buffers(NUM_IMAGE_ELEMENTS);
+	unsigned long num_allocations;
+	bool passed = true;
+
+	if (!in_file.IsOk())
+	{
+		std::cerr << in_name << ": unable to read file\n";
+		return false;
+	}
+
+	for (uint8_t ie_idx : ie_list)
+	{
+		Dpx::HdrDpxImageElement *ie = in_file.GetImageElement(ie_idx);
+		size_t row_size = ie->GetRowSizeInDatums();
+		buffers[ie_idx].int_row.resize(row_size);
+		buffers[ie_idx].float_row.resize(row_size);
+		buffers[ie_idx].double_row.resize(row_size);
+	}
+
+	// Decode
+	for (uint8_t ie_idx : ie_list)
+	{
+		Dpx::HdrDpxImageElement *ie = in_file.GetImageElement(ie_idx);
+		uint32_t height = ie->GetHeight();
+		if (height == 0)
+			continue;
+		read_row(ie, 0, buffers[ie_idx]);
+		num_allocations = g_num_allocations;
+		for (uint32_t row = 1; row < height; ++row)
+			read_row(ie, row, buffers[ie_idx]);
+		if (g_num_allocations != num_allocations)
+		{
+			std::cout << in_name << ": " << g_num_allocations - num_allocations << " allocations reading image element " << ie_idx + 1 << "\n";
+			passed = false;
+		}
+	}
+
+	// Re-encode with the same layout, uncompressed and then with RLE (where the bit depth allows it)
+	for (int use_rle = 0; use_rle < 2; ++use_rle)
+	{
+		Dpx::HdrDpxFile out_file;
+		out_file.SetHeader(Dpx::ePixelsPerLine, in_file.GetHeader(Dpx::ePixelsPerLine));
+		out_file.SetHeader(Dpx::eLinesPerImageElement, in_file.GetHeader(Dpx::eLinesPerImageElement));
+		out_file.SetHeader(Dpx::eByteOrder, in_file.GetHeader(Dpx::eByteOrder));
+		out_file.SetHeader(Dpx::eDatumMappingDirection, in_file.GetHeader(Dpx::eDatumMappingDirection));
+		for (uint8_t ie_idx : ie_list)
+		{
+			Dpx::HdrDpxImageElement *in_ie = in_file.GetImageElement(ie_idx);
+			Dpx::HdrDpxImageElement *out_ie = out_file.GetImageElement(ie_idx);
+			Dpx::HdrDpxBitDepth bit_depth = in_ie->GetHeader(Dpx::eBitDepth);
+			out_ie->SetHeader(Dpx::eDescriptor, in_ie->GetHeader(Dpx::eDescriptor));
+			out_ie->SetHeader(Dpx::eBitDepth, bit_depth);
+			out_ie->SetHeader(Dpx::ePacking, in_ie->GetHeader(Dpx::ePacking));
+			out_ie->SetHeader(Dpx::eEncoding, (use_rle && bit_depth <= Dpx::eBitDepth16) ? Dpx::eEncodingRLE : Dpx::eEncodingNoEncoding);
+		}
+		out_file.OpenForWriting(out_name);
+		if (!out_file.IsOk())
+		{
+			std::cerr << out_name << ": unable to open file for writing\n";
+			return false;
+		}
+		for (uint8_t ie_idx : ie_list)
+		{
+			Dpx::HdrDpxImageElement *in_ie = in_file.GetImageElement(ie_idx);
+			Dpx::HdrDpxImageElement *out_ie = out_file.GetImageElement(ie_idx);
+			uint32_t height = out_ie->GetHeight();
+			unsigned long ie_allocations = 0;
+			for (uint32_t row = 0; row < height; ++row)
+			{
+				read_row(in_ie, row, buffers[ie_idx]);
+				num_allocations = g_num_allocations;
+				write_row(out_ie, row, buffers[ie_idx]);
+				if (row > 0)
+					ie_allocations += g_num_allocations - num_allocations;
+			}
+			if (ie_allocations != 0)
+			{
+				std::cout << in_name << ": " << ie_allocations << " allocations writing image element " << ie_idx + 1 << (use_rle ? " with RLE\n" : " uncompressed\n");
+				passed = false;
+			}
+		}
+		out_file.Close();
+	}
+	return passed;
+}
+
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> files;
+	std::string out_name = "alloc_check_out.dpx";
+	int num_failed = 0;
+
+	if (argc < 2)
+	{
+		std::cerr << "Usage: alloc_check <infile> (<infile> ...) (-o <scratchfile>)\n";
+		std::cerr << "  <infile> - DPX file that is decoded and re-encoded\n";
+		std::cerr << "  <scratchfile> - File written while re-encoding (default alloc_check_out.dpx)\n";
+		return 0;
+	}
+
+	// Parse arguments
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = std::string(argv[i]);
+		if (!arg.compare("-o") && i + 1 < argc)
+			out_name = std::string(argv[++i]);
+		else if (arg[0] == '-')
+		{
+			std::cerr << "Unrecognized argument " << arg << "\n";
+			return -1;
+		}
+		else
+			files.push_back(arg);
+	}
+
+	for (auto &file : files)
+		if (!check_file(file, out_name))
+			num_failed++;
+	remove(out_name.c_str());
+
+	std::cout << files.size() - num_failed << " of " << files.size() << " files passed\n";
+	return (num_failed == 0) ? 0 : 1;
+}
@@ -34,7 +34,8 @@
 	@brief Converts an RGB DPX file to a different order or to/from a planar format; optionally adds or remove alpha plane
            (only works with non-floating point DPX files where all image elements have same bit depth)
 
-	This tool can change component order of a DPX file or change between planar and interleaved formats.
+	This tool can change component order of a DPX file or change between planar and interleaved formats. It can also convert a
+	DPX file to the other byte order (MSBF/LSBF) without decoding the image data.
 */
 
 #include <stdio.h>
@@ -95,11 +96,11 @@ inline string tohex(uint8_t v)
 	@return						true if found, false if not found */
 bool compare_datum_desc(Dpx::HdrDpxDescriptor destdesc, Dpx::HdrDpxDescriptor srcdesc, int datum, int &foundpos)
 {
-	std::vector<Dpx::DatumLabel> dl_src = Dpx::DescriptorToDatumList(srcdesc);
-	std::vector<Dpx::DatumLabel> dl_dest = Dpx::DescriptorToDatumList(destdesc);
+	const Dpx::DescriptorDatums &dl_src = Dpx::GetDescriptorDatums(srcdesc);
+	const Dpx::DescriptorDatums &dl_dest = Dpx::GetDescriptorDatums(destdesc);
 
-	for (unsigned int i = 0; i < dl_dest.size(); ++i)
-		if (dl_dest[datum] == dl_src[i])
+	for (unsigned int i = 0; i < dl_src.num_components; ++i)
+		if (dl_dest.labels[datum] == dl_src.labels[i])
 		{
 			foundpos = i;
 			return true;
@@ -139,6 +140,7 @@ void build_datum_map(Dpx::HdrDpxDescriptor dest, std::vector<Dpx::HdrDpxDescript
 
 // Usage:
 //  convert_descriptor input.dpx output.dpx <neworder> <planar>
+//  convert_descriptor input.dpx output.dpx -byteorder <msbf|lsbf>
 //
 // Desc types:
 //   BGR
@@ -156,8 +158,34 @@ int main(int argc, char *argv[])
 	if (argc < 5)
 	{
 		std::cerr << "Usage: convert_descriptor input.dpx output.dpx <neworder> <planar>\n";
+		std::cerr << "       convert_descriptor input.dpx output.dpx -byteorder <msbf|lsbf>\n";
 		std::cerr << "  <neworder> : RGB, BGRA, etc. Components must be present in source file except A; if A is not present all output A values will be set to 1.0)\n";
 		std::cerr << "  <planar> : 0 means use interleaved format in single IE, 1 means split components into separate planes, one per IE\n";
+		std::cerr << "  -byteorder : copy the file in the specified byte order, without decoding the image data\n";
+		return 0;
+	}
+
+	if (std::string(argv[3]) == "-byteorder")
+	{
+		std::string byte_order = std::string(argv[4]);
+		if (byte_order != "msbf" && byte_order != "lsbf")
+		{
+			std::cerr << "Unknown byte order " << byte_order << "\n";
+			return 1;
+		}
+		Dpx::HdrDpxFile f_in(argv[1]);
+		if (!f_in.IsOk())
+		{
+			dump_error_log("Read failed:\n", f_in);
+			return 1;
+		}
+		int num_errors = f_in.GetNumErrors();
+		f_in.ConvertByteOrder(argv[2], (byte_order == "msbf") ? Dpx::eMSBF : Dpx::eLSBF);
+		if (f_in.GetNumErrors() > num_errors)
+		{
+			dump_error_log("Byte order conversion failed:\n", f_in);
+			return 1;
+		}
 		return 0;
 	}
 
@@ -269,13 +297,21 @@ int main(int argc, char *argv[])
 	// If RLE enabled, rows must be written sequentially
 	// If RLE disabled, rows can be written in any order
 	// Because we wanted to support RLE, we loop over IEs then rows. If RLE is not a consideration, the loops can be switched
+	// The row buffers are reused by every destination IE, so they are only reallocated when an IE needs longer rows
+	std::vector<int32_t> datum_row_out;
+	std::vector<int32_t> datum_row_in[8];
 	// Loop over destination IEs
 	for(uint8_t out_ie_idx = 0; out_ie_idx < dest_ie_desc_list.size(); ++out_ie_idx)
 	{ 
-		std::vector<Dpx::DatumLabel> dl_dest = Dpx::DescriptorToDatumList(dest_ie_desc_list[out_ie_idx]);
-		std::vector<int32_t> datum_row_out;
-		std::vector<int32_t> datum_row_in[8];
-		std::vector<Dpx::DatumLabel> dl_src[8];
+		// An image element that is only moved (e.g., when reordering planes) is copied without decoding it, if its layout is unchanged
+		bool copied = false;
+		for (auto src_ie_index : src_ie_list)
+			if (!copied && f_in.GetImageElement(src_ie_index)->GetHeader(Dpx::eDescriptor) == dest_ie_desc_list[out_ie_idx])
+				copied = f_out.CopyImageElementRaw(f_in, src_ie_index, out_ie_idx);
+		if (copied)
+			continue;
+
+		const Dpx::DescriptorDatums &dl_dest = Dpx::GetDescriptorDatums(dest_ie_desc_list[out_ie_idx]);
 		uint8_t datum_stride[8];
 		std::vector<int> datum_ie_map;
 		std::vector<int> datum_loc;
@@ -287,15 +323,14 @@ int main(int argc, char *argv[])
 		for (auto src_ie_index : src_ie_list)
 		{
 			ie_desc_list[src_ie_index] = f_in.GetImageElement(src_ie_index)->GetHeader(Dpx::eDescriptor);
-			dl_src[src_ie_index] = Dpx::DescriptorToDatumList(ie_desc_list[src_ie_index]);
-			datum_stride[src_ie_index] = static_cast<uint8_t>(dl_src[src_ie_index].size());
+			datum_stride[src_ie_index] = Dpx::DescriptorNumComponents(ie_desc_list[src_ie_index]);
 			datum_row_in[src_ie_index].resize(datum_stride[src_ie_index] * f_in.GetHeader(Dpx::ePixelsPerLine));
 		}
 
 		build_datum_map(dest_ie_desc_list[out_ie_idx], ie_desc_list, datum_ie_map, datum_loc);
 
 		ie_out = f_out.GetImageElement(out_ie_idx);
-		datum_row_out.resize(dl_dest.size() * f_in.GetHeader(Dpx::ePixelsPerLine));
+		datum_row_out.resize(dl_dest.num_components * f_in.GetHeader(Dpx::ePixelsPerLine));
 		maxval = (1 << static_cast<uint8_t>(ie_out->GetHeader(Dpx::eBitDepth))) - 1;
 
 		for(uint32_t row = 0; row < f_in.GetHeader(Dpx::eLinesPerImageElement); ++row)
@@ -322,7 +357,7 @@ int main(int argc, char *argv[])
 				{
 					if (datum_ie_map[component] == -1)
 					{
-						if (dl_dest[component] == Dpx::DATUM_A)
+						if (dl_dest.labels[component] == Dpx::DATUM_A)
 							datum_row_out[column * num_components_out + component] = maxval;
 						else
 							std::cerr << "Unrecognized datum\n";
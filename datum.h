@@ -35,7 +35,6 @@
 
 #ifndef DATUM_H
 #define DATUM_H
-#include <string>
 
 namespace Dpx {
 
@@ -64,7 +63,7 @@ namespace Dpx {
 		DATUM_SIZE			///< Not used
 	}; 
 
-	static std::string DatumLabelToName[] =
+	constexpr const char *DatumLabelToName[] =
 	{
 		"Unspecified(1)",
 		"R",
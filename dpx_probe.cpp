@@ -0,0 +1,367 @@
+/***************************************************************************
+*    Copyright (c) 2019-2021, Broadcom Inc.
+*
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions are
+*  met:
+*
+*  1. Redistributions of source code must retain the above copyright notice,
+*     this list of conditions and the following disclaimer.
+*
+*  2. Redistributions in binary form must reproduce the above copyright
+*     notice, this list of conditions and the following disclaimer in the
+*     documentation and/or other materials provided with the distribution.
+*
+*  3. Neither the name of the copyright holder nor the names of its
+*     contributors may be used to endorse or promote products derived from
+*     this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+*  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+*  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+*  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+*  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+*  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+*  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+*  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+*  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+*  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+*  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***************************************************************************/
+
+/** @file dpx_probe.cpp
+	@brief Defines the entry point for the dpx_probe application.
+
+	This file provides a sample application that scans files and directory trees for DPX files and prints one record
+	per file with the main header fields, reading only the 2048-byte header of each file.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "hdr_dpx.h"
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <sys/stat.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#ifndef S_ISDIR
+#define S_ISDIR(m) (((m) & S_IFMT) == S_IFDIR)
+#endif
+#ifndef S_ISREG
+#define S_ISREG(m) (((m) & S_IFMT) == S_IFREG)
+#endif
+
+using namespace std;
+
+/** Number of files probed before their records are printed, which bounds memory use for very large trees */
+#define PROBE_BLOCK_SIZE 4096
+
+
+/**
+	Returns true if the file name ends with .dpx (in any case)
+
+	@param name			File name
+	@return				true if the extension is .dpx
+*/
+static bool has_dpx_extension(const std::string &name)
+{
+	if (name.size() < 4)
+		return false;
+	std::string ext = name.substr(name.size() - 4);
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	return ext == ".dpx";
+}
+
+
+/**
+	Adds the DPX files found in a directory tree to a list, in sorted order within each directory
+
+	@param[in] path			Directory to scan
+	@param[out] files		List the file names are appended to
+*/
+static void scan_directory(const std::string &path, std::vector<std::string> &files)
+{
+	std::vector<std::string> entries;
+#ifdef _WIN32
+	WIN32_FIND_DATAA find_data;
+	HANDLE find_handle = FindFirstFileA((path + "\\*").c_str(), &find_data);
+
+	if (find_handle == INVALID_HANDLE_VALUE)
+	{
+		std::cerr << "Unable to open directory " << path << "\n";
+		return;
+	}
+	do
+	{
+		std::string name(find_data.cFileName);
+		if (name != "." && name != "..")
+			entries.push_back(name);
+	} while (FindNextFileA(find_handle, &find_data));
+	FindClose(find_handle);
+#else
+	DIR *dir = opendir(path.c_str());
+
+	if (dir == NULL)
+	{
+		std::cerr << "Unable to open directory " << path << "\n";
+		return;
+	}
+	for (struct dirent *ent = readdir(dir); ent != NULL; ent = readdir(dir))
+	{
+		std::string name(ent->d_name);
+		if (name != "." && name != "..")
+			entries.push_back(name);
+	}
+	closedir(dir);
+#endif
+	std::sort(entries.begin(), entries.end());
+
+	for (auto &name : entries)
+	{
+		struct stat st;
+		std::string full_name = path + "/" + name;
+		if (stat(full_name.c_str(), &st) != 0)
+			continue;
+		if (S_ISDIR(st.st_mode))
+			scan_directory(full_name, files);
+		else if (S_ISREG(st.st_mode) && has_dpx_extension(name))
+			files.push_back(full_name);
+	}
+}
+
+
+/**
+	Quotes a CSV field if it contains a separator, quote or line break
+
+	@param s			Field value
+	@return				Field as written to the CSV output
+*/
+static std::string csv_field(const std::string &s)
+{
+	if (s.find_first_of(",\"\r\n") == std::string::npos)
+		return s;
+	std::string out = "\"";
+	for (char c : s)
+	{
+		if (c == '"')
+			out += '"';
+		out += c;
+	}
+	return out + "\"";
+}
+
+
+/**
+	Converts a string to a quoted JSON string
+
+	@param s			String to convert
+	@return				JSON string literal
+*/
+static std::string json_string(const std::string &s)
+{
+	std::stringstream ss;
+	ss << '"';
+	for (unsigned char c : s)
+	{
+		if (c == '"' || c == '\\')
+			ss << '\\' << c;
+		else if (c < 0x20)
+			ss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+		else
+			ss << c;
+	}
+	ss << '"';
+	return ss.str();
+}
+
+
+/** One field of the record printed for a file */
+struct ProbeField
+{
+	std::string name;   ///< field name (JSON key)
+	std::string value;   ///< field value, empty if not available
+	bool is_number;   ///< true if the value is written as a JSON number
+};
+
+
+/**
+	Formats the time code header field as HH:MM:SS:FF (empty if undefined)
+
+	@param f			DPX file object holding the header
+	@return				Time code string
+*/
+static std::string time_code_string(const Dpx::HdrDpxFile &f)
+{
+	Dpx::SMPTETimeCode tc = f.GetHeader(Dpx::eSMPTETimeCode);
+	uint32_t raw;
+
+	memcpy(&raw, &tc, sizeof(uint32_t));
+	if (raw == UNDEFINED_U32)
+		return "";
+	std::stringstream ss;
+	ss << tc.h_tens << tc.h_units << ":" << tc.m_tens << tc.m_units << ":" << tc.s_tens << tc.s_units << ":" << tc.F_tens << tc.F_units;
+	return ss.str();
+}
+
+
+/**
+	Probes one file and formats its record
+
+	@param f			DPX file object to probe with (reused between files)
+	@param filename		File to probe
+	@param json			true for a JSON object, false for a CSV line
+	@param validate		true to validate the header and report the number of messages
+	@return				Record, without a trailing line break
+*/
+static std::string probe_file(Dpx::HdrDpxFile &f, const std::string &filename, bool json, bool validate)
+{
+	std::vector<std::string> fields;
+	std::string descriptors, bit_depths;
+	bool ok;
+
+	f.Probe(filename);
+	ok = f.IsOk();
+	if (ok)
+	{
+		for (auto ie_idx : f.GetIEIndexList())
+		{
+			Dpx::HdrDpxImageElement *ie = f.GetImageElement(ie_idx);
+			descriptors += (descriptors.empty() ? "" : ";") + std::to_string(ie->GetHeader(Dpx::eDescriptor));
+			bit_depths += (bit_depths.empty() ? "" : ";") + std::to_string(ie->GetHeader(Dpx::eBitDepth));
+		}
+	}
+
+	// Fields in output order; multiple image elements are separated by ';'
+	uint32_t frame_position = ok ? f.GetHeader(Dpx::eFramePositionInSequence) : UNDEFINED_U32;
+	std::vector<ProbeField> record =
+	{
+		{ "file", filename, false },
+		{ "ok", ok ? "1" : "0", true },
+		{ "hdr", ok ? (f.IsHdr() ? "1" : "0") : "", true },
+		{ "byte_order", ok ? (f.GetHeader(Dpx::eByteOrder) == Dpx::eMSBF ? "msbf" : "lsbf") : "", false },
+		{ "width", ok ? std::to_string(f.GetHeader(Dpx::ePixelsPerLine)) : "", true },
+		{ "height", ok ? std::to_string(f.GetHeader(Dpx::eLinesPerImageElement)) : "", true },
+		{ "elements", ok ? std::to_string(f.GetIEIndexList().size()) : "", true },
+		{ "descriptors", descriptors, false },
+		{ "bit_depths", bit_depths, false },
+		{ "time_code", ok ? time_code_string(f) : "", false },
+		{ "frame_position", frame_position == UNDEFINED_U32 ? "" : std::to_string(frame_position), true }
+	};
+	if (validate)
+	{
+		if (ok)
+			f.Validate();
+		record.push_back({ "messages", std::to_string(f.GetNumErrors()), true });
+	}
+
+	std::string line;
+	for (auto &field : record)
+	{
+		if (!json)
+			line += (line.empty() ? "" : ",") + csv_field(field.value);
+		else if (field.value.empty())
+			line += (line.empty() ? "{" : ",") + json_string(field.name) + ":null";
+		else
+			line += (line.empty() ? "{" : ",") + json_string(field.name) + ":" + (field.is_number ? field.value : json_string(field.value));
+	}
+	return json ? line + "}" : line;
+}
+
+
+/**
+	Main entry point for the app
+
+	@param argc		Number of command line arguments.
+	@param argv		Array of char strings, each containing one command-line argument
+	@return			Error code
+*/
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> paths;
+	std::vector<std::string> files;
+	bool json = false;
+	bool validate = false;
+	unsigned int num_threads = 0;
+
+	if (argc < 2)
+	{
+		std::cerr << "Usage: dpx_probe <path> (<path> ...) (-json) (-validate) (-threads <n>)\n";
+		std::cerr << "  <path> - DPX file, or directory that is scanned recursively for files with a .dpx extension\n";
+		std::cerr << "  -json - Print one JSON object per line instead of CSV\n";
+		std::cerr << "  -validate - Validate each header and report the number of messages logged\n";
+		std::cerr << "  <n> - Number of threads used to probe files (default 0 uses all hardware threads)\n";
+		return 0;
+	}
+
+	// Parse arguments
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = std::string(argv[i]);
+		if (!arg.compare("-json"))
+			json = true;
+		else if (!arg.compare("-validate"))
+			validate = true;
+		else if (!arg.compare("-threads") && i + 1 < argc)
+			num_threads = static_cast<unsigned int>(atoi(argv[++i]));
+		else if (arg[0] == '-')
+		{
+			std::cerr << "Unrecognized argument " << arg << "\n";
+			return -1;
+		}
+		else
+			paths.push_back(arg);
+	}
+	if (num_threads == 0)
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	for (auto &path : paths)
+	{
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0)
+			std::cerr << "Unable to find " << path << "\n";
+		else if (S_ISDIR(st.st_mode))
+			scan_directory(path, files);
+		else
+			files.push_back(path);
+	}
+
+	if (!json)
+		std::cout << "file,ok,hdr,byte_order,width,height,elements,descriptors,bit_depths,time_code,frame_position" << (validate ? ",messages" : "") << "\n";
+
+	// Each thread probes every num_threads-th file of a block with its own file object
+	std::vector<std::string> records(std::min<size_t>(files.size(), PROBE_BLOCK_SIZE));
+	for (size_t block_start = 0; block_start < files.size(); block_start += PROBE_BLOCK_SIZE)
+	{
+		size_t block_size = std::min<size_t>(files.size() - block_start, PROBE_BLOCK_SIZE);
+		std::atomic<size_t> next(0);
+		std::vector<std::thread> threads;
+		for (unsigned int t = 0; t < num_threads; ++t)
+		{
+			threads.push_back(std::thread([&]()
+			{
+				Dpx::HdrDpxFile f;
+				for (size_t i = next++; i < block_size; i = next++)
+					records[i] = probe_file(f, files[block_start + i], json, validate);
+			}));
+		}
+		for (auto &t : threads)
+			t.join();
+		for (size_t i = 0; i < block_size; ++i)
+			std::cout << records[i] << "\n";
+	}
+	return 0;
+}
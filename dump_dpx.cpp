@@ -43,6 +43,10 @@
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#ifdef _MSC_VER
+#include <io.h>
+#include <fcntl.h>
+#endif
 
 using namespace std;
 
@@ -379,6 +383,25 @@ void open_raw_files(std::vector<std::shared_ptr<std::ofstream>> &fp_list, uint8_
 }
 
 
+/**
+	Function to size the row buffer that matches the sample type of an image element
+
+	@param[in] ie				Image element that is about to be decoded
+	@param[out] float_row		Row buffer for 32-bit floating point samples
+	@param[out] double_row		Row buffer for 64-bit floating point samples
+	@param[out] int_row			Row buffer for integer samples
+*/
+void resize_row_buffer(Dpx::HdrDpxImageElement *ie, std::vector<float> &float_row, std::vector<double> &double_row, std::vector<int32_t> &int_row)
+{
+	if (ie->GetHeader(Dpx::eBitDepth) == Dpx::eBitDepthR32)
+		float_row.resize(ie->GetRowSizeInDatums());
+	else if (ie->GetHeader(Dpx::eBitDepth) == Dpx::eBitDepthR64)
+		double_row.resize(ie->GetRowSizeInDatums());
+	else
+		int_row.resize(ie->GetRowSizeInDatums());
+}
+
+
 /**
 	Main entry point for the app
 
@@ -398,7 +421,7 @@ int main(int argc, char *argv[])
 	if (argc < 2)
 	{
 		std::cerr << "Usage: dump_dpx <dpxfile> (-rawout <out_rawfile_base> (-plane_order <plane_order>) (-bit_depth_conv <bit_depth_conv>) (-dump_full_range))\n";
-		std::cerr << "  <dpxfile> - DPX file to dump\n";
+		std::cerr << "  <dpxfile> - DPX file to dump (- to read from standard input)\n";
 		std::cerr << "  <out_rawfile_base> - Output filename base name. The output extension will be .#.<plane_type>, where # is the first image element number and <plane_type> is y,u,v,r,g,b,a, or g0-7\n\n";
 		std::cerr << "  <bit_depth_conv> - Convert DPX file to specified bit depth. If unspecified, uses bit depth from DPX.\n";
 		std::cerr << "  -dump_full_range - If present, the output raw files will be full range; if absent, the output raw files will be limited range (float/double output always scaled to 0-1.0)\n";
@@ -442,7 +465,16 @@ int main(int argc, char *argv[])
 	}
 
 	// Shorthand to open a DPX file for reading
-	Dpx::HdrDpxFile  f(filename);
+	Dpx::HdrDpxFile  f;
+	if (!filename.compare("-"))
+	{
+#ifdef _MSC_VER
+		_setmode(_fileno(stdin), _O_BINARY);
+#endif
+		f.OpenForReading(std::cin);
+	}
+	else
+		f.OpenForReading(filename);
 
 	if (!f.IsOk())   // can't open, unrecognized format
 	{
@@ -469,7 +501,10 @@ int main(int argc, char *argv[])
 	std::cout << f;  // Dump header
 
 
-	// Output pixel data
+	// Output pixel data (decoded one row at a time into a row buffer that is reused for every row and image element)
+	std::vector<float> float_row;
+	std::vector<double> double_row;
+	std::vector<int32_t> int_row;
 	if (output_raw)   // Raw planes to files
 	{
 		// Make a list of all planes with corresponding IEs
@@ -477,6 +512,7 @@ int main(int argc, char *argv[])
 		{
 			std::vector<std::shared_ptr<std::ofstream>> raw_fp_list;
 			Dpx::HdrDpxImageElement *ie = f.GetImageElement(src_ie_idx);
+			resize_row_buffer(ie, float_row, double_row, int_row);
 			uint8_t num_components = ie->GetNumberOfComponents();
 			uint8_t alt_chroma;
 			std::vector<bool> is_chroma;
@@ -490,9 +526,8 @@ int main(int argc, char *argv[])
 			{
 				if (ie->GetHeader(Dpx::eBitDepth) == Dpx::eBitDepthR32)  // 32-bit float
 				{
-					std::vector<float> rowdata;
-					rowdata.resize(ie->GetRowSizeInDatums());
-					ie->Dpx2AppPixels(row, static_cast<float *>(rowdata.data()));
+					float *rowdata = float_row.data();
+					ie->Dpx2AppPixels(row, rowdata);
 					for (uint32_t column = 0; column < ie->GetWidth(); column++)
 					{
 						for (uint8_t c = 0; c < num_components; ++c)
@@ -506,9 +541,8 @@ int main(int argc, char *argv[])
 				}
 				else if (ie->GetHeader(Dpx::eBitDepth) == Dpx::eBitDepthR64)  // 64-bit float
 				{
-					std::vector<double> rowdata;
-					rowdata.resize(ie->GetRowSizeInDatums());
-					ie->Dpx2AppPixels(row, static_cast<double *>(rowdata.data()));
+					double *rowdata = double_row.data();
+					ie->Dpx2AppPixels(row, rowdata);
 					for (uint32_t column = 0; column < ie->GetWidth(); ++column)
 					{
 						for (uint8_t c = 0; c < num_components; ++c)
@@ -522,9 +556,8 @@ int main(int argc, char *argv[])
 				}
 				else
 				{
-					std::vector<int32_t> rowdata;
-					rowdata.resize(ie->GetRowSizeInDatums());
-					ie->Dpx2AppPixels(row, static_cast<int32_t *>(rowdata.data()));
+					int32_t *rowdata = int_row.data();
+					ie->Dpx2AppPixels(row, rowdata);
 					for (uint32_t column = 0; column < ie->GetWidth(); ++column)
 					{
 						for (uint8_t c = 0; c < num_components; ++c)
@@ -548,6 +581,7 @@ int main(int argc, char *argv[])
 		for (auto src_ie_idx : f.GetIEIndexList())
 		{
 			Dpx::HdrDpxImageElement *ie = f.GetImageElement(src_ie_idx);
+			resize_row_buffer(ie, float_row, double_row, int_row);
 
 			std::cout << "Component types for image element " << src_ie_idx << ": ";
 			for (auto c : ie->GetDatumLabels())
@@ -559,10 +593,9 @@ int main(int argc, char *argv[])
 				std::cout << "\n" << row << ": ";
 				if (ie->GetHeader(Dpx::eBitDepth) == Dpx::eBitDepthR32)  // 32-bit float
 				{
-					std::vector<float> rowdata;
+					float *rowdata = float_row.data();
 					uint32_t datum_idx = 0;
-					rowdata.resize(ie->GetRowSizeInDatums());
-					ie->Dpx2AppPixels(row, static_cast<float *>(rowdata.data()));
+					ie->Dpx2AppPixels(row, rowdata);
 					while (datum_idx < ie->GetWidth() * ie->GetNumberOfComponents())
 					{
 						std::cout << "(";
@@ -575,10 +608,9 @@ int main(int argc, char *argv[])
 				}
 				else if (ie->GetHeader(Dpx::eBitDepth) == Dpx::eBitDepthR64)  // 64-bit float
 				{
-					std::vector<double> rowdata;
+					double *rowdata = double_row.data();
 					uint32_t datum_idx = 0;
-					rowdata.resize(ie->GetRowSizeInDatums());
-					ie->Dpx2AppPixels(row, static_cast<double *>(rowdata.data()));
+					ie->Dpx2AppPixels(row, rowdata);
 					for (uint32_t x = 0; x < ie->GetWidth(); ++x)
 					{
 						std::cout << "(";
@@ -591,10 +623,9 @@ int main(int argc, char *argv[])
 				}
 				else
 				{
-					std::vector<int32_t> rowdata;
+					int32_t *rowdata = int_row.data();
 					int32_t datum_idx = 0;
-					rowdata.resize(ie->GetRowSizeInDatums());
-					ie->Dpx2AppPixels(row, static_cast<int32_t *>(rowdata.data()));
+					ie->Dpx2AppPixels(row, rowdata);
 					for (uint32_t x = 0; x < ie->GetWidth(); ++x)
 					{
 						std::cout << "(";
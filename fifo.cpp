@@ -85,17 +85,19 @@ Fifo::Fifo(const Fifo &f)
 uint32_t Fifo::GetBitsUi(int n)
 {
 	unsigned int d = 0;
-	int i;
-	unsigned char b;
+	int bitpos, nb;
 
 	ASSERT_MSG(m_fullness >= n, "FIFO underflow has occured");
 
-	for (i = 0; i<n; ++i)
+	// Take as many bits as possible from each byte (the FIFO size is a whole number of bytes, so a byte never wraps)
+	while (n > 0)
 	{
-		b = (m_data[m_read_ptr / 8] >> (7 - (m_read_ptr % 8))) & 1;
-		d = (d << 1) + b;
-		m_fullness--;
-		m_read_ptr++;
+		bitpos = m_read_ptr % 8;
+		nb = (n < 8 - bitpos) ? n : 8 - bitpos;
+		d = (d << nb) | ((m_data[m_read_ptr / 8] >> (8 - bitpos - nb)) & ((1u << nb) - 1));
+		n -= nb;
+		m_fullness -= nb;
+		m_read_ptr += nb;
 		if (m_read_ptr >= m_size)
 			m_read_ptr = 0;
 	}
@@ -110,23 +112,12 @@ uint32_t Fifo::GetBitsUi(int n)
 */
 int32_t Fifo::GetBitsI(int n)
 {
-	unsigned int d = 0;
-	int i;
-	unsigned char b;
+	unsigned int d;
 	int sign = 0;
 
-	ASSERT_MSG(m_fullness >= n, "FIFO underflow has occured");
-
-	for (i = 0; i<n; ++i)
-	{
-		b = (m_data[m_read_ptr / 8] >> (7 - (m_read_ptr % 8))) & 1;
-		if (i == 0) sign = b;
-		d = (d << 1) + b;
-		m_fullness--;
-		m_read_ptr++;
-		if (m_read_ptr >= m_size)
-			m_read_ptr = 0;
-	}
+	d = GetBitsUi(n);
+	if (n > 0)
+		sign = (d >> (n - 1)) & 1;   // first bit read
 
 	if (sign)
 	{
@@ -200,22 +191,24 @@ void Fifo::PutBits(int32_t d, int nbits)
 uint32_t Fifo::FlipGetBitsUi(int n)
 {
 	unsigned int d = 0;
-	int i;
-	unsigned char b;
+	int i = 0;
+	int bitpos, nb;
 
 	ASSERT_MSG(m_fullness >= n, "FIFO has underflowed");
 
 	// Note, you need to allocate 32 bits more than you plan to use so the reordering doesn't get overwritten
 	// Also, you need to allocate a 32-bit multiple size
-	for (i = 0; i<n; ++i)
+	while (i < n)
 	{
 		int idx1, idx2;
 		idx1 = (m_read_ptr / 32) * 4;
 		idx2 = (31 - (m_read_ptr % 32)) / 8;
-		b = (m_data[idx1 + idx2] >> ((m_read_ptr % 8))) & 1;
-		d |= (b << i);
-		m_fullness--;
-		m_read_ptr++;
+		bitpos = m_read_ptr % 8;
+		nb = (n - i < 8 - bitpos) ? n - i : 8 - bitpos;
+		d |= ((m_data[idx1 + idx2] >> bitpos) & ((1u << nb) - 1)) << i;
+		i += nb;
+		m_fullness -= nb;
+		m_read_ptr += nb;
 		if (m_read_ptr >= m_size)
 			m_read_ptr = 0;
 	}
@@ -230,28 +223,12 @@ uint32_t Fifo::FlipGetBitsUi(int n)
 */
 int32_t Fifo::FlipGetBitsI(int n)
 {
-	unsigned int d = 0;
-	int i;
-	unsigned char b;
+	unsigned int d;
 	int sign = 0;
 
-	ASSERT_MSG(m_fullness >= n, "FIFO has underflowed");
-
-	// Note, you need to allocate 32 bits more than you plan to use so the reordering doesn't get overwritten
-	// Also, you need to allocate a 32-bit multiple size
-	for (i = 0; i<n; ++i)
-	{
-		int idx1, idx2;
-		idx1 = (m_read_ptr / 32) * 4;
-		idx2 = (31 - (m_read_ptr % 32)) / 8;
-		b = (m_data[idx1 + idx2] >> ((m_read_ptr % 8))) & 1;
-		sign = b;  // MSbit
-		d |= (b << i);
-		m_fullness--;
-		m_read_ptr++;
-		if (m_read_ptr >= m_size)
-			m_read_ptr = 0;
-	}
+	d = FlipGetBitsUi(n);
+	if (n > 0)
+		sign = (d >> (n - 1)) & 1;  // MSbit
 
 	if (sign)
 	{
@@ -53,18 +53,32 @@ void FileMap::AddRegion(uint32_t region_start, uint32_t region_end, int tag)
 uint32_t FileMap::FindEmptySpace(uint32_t region_size, int tag)
 {
 	unsigned int i;
+	uint32_t start;
 	if (m_r.size() == 0)
 		return UINT32_MAX;
 	for (i = 0; i < m_r.size() - 1; ++i)
 	{
-		if (m_r[i + 1].start - m_r[i].end >= region_size)
+		start = AlignUp(m_r[i].end);
+		if (m_r[i + 1].start >= start && m_r[i + 1].start - start >= region_size)
 		{
-			AddRegion(m_r[i].end, m_r[i].end + region_size, tag);
-			return m_r[i].end;
+			AddRegion(start, start + region_size, tag);
+			return start;
 		}
 	}
-	AddRegion(m_r[i].end, m_r[i].end + region_size, tag);
-	return(m_r[i].end);
+	start = AlignUp(m_r[i].end);
+	AddRegion(start, start + region_size, tag);
+	return(start);
+}
+
+void FileMap::SetAlignment(uint32_t alignment)
+{
+	m_alignment = (alignment == 0) ? 1 : alignment;
+}
+
+uint32_t FileMap::AlignUp(uint32_t offset) const
+{
+	uint64_t aligned = (static_cast<uint64_t>(offset) + m_alignment - 1) / m_alignment * m_alignment;
+	return (aligned > UINT32_MAX) ? UINT32_MAX : static_cast<uint32_t>(aligned);
 }
 
 bool FileMap::CheckCollisions()
@@ -108,6 +122,8 @@ void FileMap::AddRLEIE(uint8_t ie_index, uint32_t data_offset, uint32_t est_size
 	ie.data_offset = data_offset;
 	ie.est_size = est_size;
 	m_rle_ie.push_back(ie);
+	// The region of an RLE IE that is placed later is added after the last row of the previous one is written, so make room for it now
+	m_r.reserve(m_r.size() + m_rle_ie.size());
 }
 
 uint8_t FileMap::GetActiveRLEIndex()
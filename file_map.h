@@ -66,10 +66,13 @@ namespace Dpx
 			@param region_end			ending offset of region (in bytes)
 			@param tag					unique tag describing what region contains */
 		void AddRegion(uint32_t region_start, uint32_t region_end, int tag);
-		/** Find an empty space within the map (or append if insufficient empty space is available)
+		/** Find an empty space within the map (or append if insufficient empty space is available), starting on an alignment boundary
 			@param region_size			size of new region
 			@param tag					unique tag describing what new region contains */
 		uint32_t FindEmptySpace(uint32_t region_size, int tag);
+		/** Set the alignment of the regions placed by FindEmptySpace()
+			@param alignment			alignment in bytes (1 for none) */
+		void SetAlignment(uint32_t alignment);
 		/** Check the map for any collisions and return true if there are any */
 		bool CheckCollisions();
 		/** Change the end offset of the region corresponding to the specified tag 
@@ -93,9 +96,12 @@ namespace Dpx
 	private:
 		/** Sort regions by starting offset */
 		void SortRegions(void);
+		/** Round an offset up to the region alignment */
+		uint32_t AlignUp(uint32_t offset) const;
 		std::vector<FileRegion> m_r; ///< region list
 		std::vector<RLEImageElement> m_rle_ie;  ///< RLE IE list
 		uint8_t m_rle_ie_idx;   ///< Current RLE IE index
+		uint32_t m_alignment = 1;   ///< Alignment of regions placed by FindEmptySpace()
 	};
 
 }
\ No newline at end of file
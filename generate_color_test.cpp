@@ -47,6 +47,7 @@
 #include <vector>
 #include <string>
 #include <cstring>
+#include <algorithm>
 
 using namespace std;
 
@@ -856,6 +857,13 @@ int main(int argc, char *argv[])
 	Dpx::HdrDpxByteOrder byte_order = Dpx::eNativeByteOrder;  
 	Dpx::HdrDpxPacking packing = Dpx::ePackingPacked;   // 0 => packed, 1 => method A, 2 => Method B
 	Dpx::HdrDpxEncoding rle_encoding = Dpx::eEncodingNoEncoding;
+	bool rle_row_index = false;
+	unsigned int num_threads = 1;
+	bool rle_buffer = false;
+	bool rle_optimal = false;
+	uint32_t data_alignment = 1;
+	bool align_rows = false;
+	bool preallocate = false;
 
 	if ((argc % 2) != 1)
 	{
@@ -878,7 +886,14 @@ int main(int argc, char *argv[])
 		std::cout << " -dmd <l2r|r2l>";
 		std::cout << " -order <msbf|lsbf>";
 		std::cout << " -packing <packed|ma|mb>";
-		std::cout << " -encoding <1|0>\n";
+		std::cout << " -encoding <1|0|2>";
+		std::cout << " -rowindex <1|0>";
+		std::cout << " -threads <n>";
+		std::cout << " -rlebuffer <1|0>";
+		std::cout << " -rleopt <1|0>";
+		std::cout << " -align <bytes>";
+		std::cout << " -alignrows <1|0>";
+		std::cout << " -prealloc <1|0>\n";
 		std::cout << "\n\nSupported list of formats:  CbYCr, CbYCrA, CbYCrY422, CbYACrYA422, YCbCr422p, YCbCrA422p, CYY420, CYAYA420, YCbCr420p, YCbCrA420p, BGR, BGRA, ARGB, RGB, RGBA, ABGR\n";
 		return 0;
 	}
@@ -925,7 +940,24 @@ int main(int argc, char *argv[])
 			i++;
 		}
 		else if (!strcmp(argv[i], "-encoding"))
-			rle_encoding = (atoi(argv[++i]) == 1) ? Dpx::eEncodingRLE : Dpx::eEncodingNoEncoding;
+		{
+			int encoding = atoi(argv[++i]);
+			rle_encoding = (encoding == 1) ? Dpx::eEncodingRLE : ((encoding == 2) ? Dpx::eEncodingAuto : Dpx::eEncodingNoEncoding);
+		}
+		else if (!strcmp(argv[i], "-rowindex"))
+			rle_row_index = atoi(argv[++i]) == 1;
+		else if (!strcmp(argv[i], "-threads"))
+			num_threads = static_cast<unsigned int>(atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-rlebuffer"))
+			rle_buffer = atoi(argv[++i]) == 1;
+		else if (!strcmp(argv[i], "-rleopt"))
+			rle_optimal = atoi(argv[++i]) == 1;
+		else if (!strcmp(argv[i], "-align"))
+			data_alignment = static_cast<uint32_t>(atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-alignrows"))
+			align_rows = atoi(argv[++i]) == 1;
+		else if (!strcmp(argv[i], "-prealloc"))
+			preallocate = atoi(argv[++i]) == 1;
 		else
 		{
 			std::cerr << "Unrecognized parameter: " << argv[i] << "\n";
@@ -945,6 +977,10 @@ int main(int argc, char *argv[])
 	cout << "Byte order:  " << static_cast<int>(byte_order) << endl;
 	cout << "Packing:  " << static_cast<int>(packing) << endl;
 	cout << "RLE encoding:  " << static_cast<int>(rle_encoding) << endl;
+	cout << "RLE row index:  " << rle_row_index << endl;
+	cout << "Encoding threads:  " << num_threads << endl;
+	cout << "Buffer RLE image elements:  " << rle_buffer << endl;
+	cout << "Size-optimal RLE:  " << rle_optimal << endl;
 
 	alphaval = (1 << bpc) - 1;   // Always use max alpha
 
@@ -1038,6 +1074,79 @@ int main(int argc, char *argv[])
 	dpxf.SetHeader(Dpx::eRightToUseOrCopyright, "(C) 20XX Not a real copyright");  // Key is a string, value matches data type
 	dpxf.SetHeader(Dpx::eDatumMappingDirection, Dpx::eDatumMappingDirectionL2R);
 
+	// Optionally store RLE row offsets in the user data section so readers can access rows in any order
+	dpxf.EnableRLERowIndex(rle_row_index);
+	// Optionally hold RLE image elements in memory until Close() so they can be written in any order
+	dpxf.EnableRLEBuffering(rle_buffer);
+	// Optionally choose RLE runs that give the smallest file instead of using the greedy encoder
+	dpxf.EnableSizeOptimalRLE(rle_optimal);
+	// Optionally start image elements (and rows) on aligned offsets, e.g., 4096 for direct I/O
+	dpxf.SetDataAlignment(data_alignment, align_rows);
+	// Optionally allocate disk space for the whole file up front
+	dpxf.EnablePreallocation(preallocate);
+
+	// Fill one row of datums for an image element with the color bar pattern
+	auto generate_row = [&](const IEDescriptor &desc, uint32_t row, std::vector<int32_t> &datum_row)
+	{
+		uint32_t datum_idx = 0;
+		const uint32_t ie_width = width / (desc.h_subs ? 2 : 1);
+		const Dpx::DescriptorDatums &datums = Dpx::GetDescriptorDatums(desc.descriptor);
+
+		datum_row.resize(ie_width * datums.num_components);
+		for (uint32_t column = 0; column < ie_width; ++column)
+		{
+			int32_t cbcomps[3];
+			bar_colors_e color = cbgen.GetPixelColor(column * (desc.h_subs ? 2 : 1), row * (desc.v_subs ? 2 : 1));
+			colormap.GetComponents(color, cbcomps, cbgen.m_ramp_frac);
+			for (uint8_t c = 0; c < datums.num_components; ++c)
+			{
+				const Dpx::DatumLabel dl = datums.labels[c];
+				if (dl == Dpx::DATUM_A || dl == Dpx::DATUM_A2)
+					datum_row[datum_idx++] = alphaval;
+				else if (dl == Dpx::DATUM_R || dl == Dpx::DATUM_Y)
+					datum_row[datum_idx++] = cbcomps[0];
+				else if (dl == Dpx::DATUM_G || dl == Dpx::DATUM_CB)
+					datum_row[datum_idx++] = cbcomps[1];
+				else if (dl == Dpx::DATUM_B || dl == Dpx::DATUM_CR)
+					datum_row[datum_idx++] = cbcomps[2];
+				else if (dl == Dpx::DATUM_C)
+				{
+					if (row & 1)   // odd row (CR)
+						datum_row[datum_idx++] = cbcomps[2];
+					else           // Even row (CB)
+						datum_row[datum_idx++] = cbcomps[1];
+				}
+				else if (dl == Dpx::DATUM_Y2)
+				{
+					color = cbgen.GetPixelColor(column * (desc.h_subs ? 2 : 1) + 1, row * (desc.v_subs ? 2 : 1));
+					colormap.GetComponents(color, cbcomps, cbgen.m_ramp_frac);
+					datum_row[datum_idx++] = cbcomps[0];
+				}
+			}
+		}
+		if (datum_idx != (width * datums.num_components / (desc.h_subs ? 2 : 1)))
+		{
+			printf("Unexpected datum index\n");
+			getchar();
+		}
+	};
+
+	// With automatic encoding selection, the library decides between RLE and uncompressed from a few sample rows
+	if (rle_encoding == Dpx::eEncodingAuto)
+	{
+		for (ie_idx = 0; ie_idx < iemap.GetNumberOfIEs(); ++ie_idx)
+		{
+			IEDescriptor desc = iemap.GetDescriptor(ie_idx);
+			uint32_t ie_height = height / (desc.v_subs ? 2 : 1);
+			std::vector<int32_t> datum_row;
+			for (uint32_t sample = 0; sample < 5 && ie_height > 0; ++sample)
+			{
+				generate_row(desc, sample * (ie_height - 1) / 4, datum_row);
+				dpxf.GetImageElement(ie_idx)->AddEncodingSampleRow(datum_row.data());
+			}
+		}
+	}
+
 
 	// Start writing file
 	dpxf.OpenForWriting(fname);
@@ -1050,53 +1159,36 @@ int main(int argc, char *argv[])
 		dump_error_log("File write message log:\n", dpxf);
 	}
 
-	// If RLE enabled, rows must be written sequentially
+	// If RLE enabled, rows must be written sequentially (unless RLE buffering is enabled)
 	// If RLE disabled, rows can be written in any order
-	for (ie_idx = 0; ie_idx < iemap.GetNumberOfIEs(); ++ie_idx)
+	for (uint8_t ie_count = 0; ie_count < iemap.GetNumberOfIEs(); ++ie_count)
 	{
+		// With RLE buffering, write the image elements in reverse order to show that any order works
+		ie_idx = rle_buffer ? iemap.GetNumberOfIEs() - 1 - ie_count : ie_count;
 		Dpx::HdrDpxImageElement *ie = dpxf.GetImageElement(ie_idx);
 		std::vector<int32_t> datum_row;
+		std::vector<int32_t> datum_frame;
 		IEDescriptor desc = iemap.GetDescriptor(ie_idx);
-		datum_row.resize(ie->GetRowSizeInDatums());
+		const size_t row_size = ie->GetRowSizeInDatums();
+		if (num_threads != 1)
+			datum_frame.reserve(row_size * ie->GetHeight());
 		for (uint32_t row = 0; row < ie->GetHeight(); ++row)
 		{
-			uint32_t datum_idx = 0;
-			for (uint32_t column = 0; column < ie->GetWidth(); ++column)
-			{
-				int32_t cbcomps[3];
-				bar_colors_e color = cbgen.GetPixelColor(column * (desc.h_subs ? 2 : 1), row * (desc.v_subs ? 2 : 1));
-				colormap.GetComponents(color, cbcomps, cbgen.m_ramp_frac);
-				for (auto dl : Dpx::DescriptorToDatumList(desc.descriptor))
-				{
-					if (dl == Dpx::DATUM_A || dl == Dpx::DATUM_A2)
-						datum_row[datum_idx++] = alphaval;
-					else if (dl == Dpx::DATUM_R || dl == Dpx::DATUM_Y)
-						datum_row[datum_idx++] = cbcomps[0];
-					else if (dl == Dpx::DATUM_G || dl == Dpx::DATUM_CB)
-						datum_row[datum_idx++] = cbcomps[1];
-					else if (dl == Dpx::DATUM_B || dl == Dpx::DATUM_CR)
-						datum_row[datum_idx++] = cbcomps[2];
-					else if (dl == Dpx::DATUM_C)
-					{
-						if (row & 1)   // odd row (CR)
-							datum_row[datum_idx++] = cbcomps[2];
-						else           // Even row (CB)
-							datum_row[datum_idx++] = cbcomps[1];
-					}
-					else if (dl == Dpx::DATUM_Y2)
-					{
-						color = cbgen.GetPixelColor(column * (desc.h_subs ? 2 : 1) + 1, row * (desc.v_subs ? 2 : 1));
-						colormap.GetComponents(color, cbcomps, cbgen.m_ramp_frac);
-						datum_row[datum_idx++] = cbcomps[0];
-					}
-				}
-			}
-			if (datum_idx != (width * Dpx::DescriptorToDatumList(desc.descriptor).size() / (desc.h_subs ? 2 : 1)))
+			generate_row(desc, row, datum_row);
+			if (num_threads == 1)
+				ie->App2DpxPixels(row, datum_row.data());
+			else    // App2DpxPixelRows() reads the frame at a stride of one image element row, which can be shorter than the generated row
+				datum_frame.insert(datum_frame.end(), datum_row.begin(), datum_row.begin() + std::min(datum_row.size(), row_size));
+		}
+		// With multiple threads, the whole image element is encoded at once
+		if (num_threads != 1)
+		{
+			if (datum_frame.size() != row_size * ie->GetHeight())
 			{
-				printf("Unexpected datum index\n");
-				getchar();
+				std::cerr << "Generated rows do not fill image element " << ie_idx + 1 << "\n";
+				return 1;
 			}
-			ie->App2DpxPixels(row, datum_row.data());
+			ie->App2DpxPixelRows(0, ie->GetHeight(), datum_frame.data(), num_threads);
 		}
 	}
 
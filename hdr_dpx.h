@@ -58,9 +58,20 @@
 #define RLE_MARGIN   (1.0/127)   // = ~1% margin means we assume that in the worst case an RLE image element might be slightly bigger than uncompressed 
                                   //         (1-component 8-bit IE where RLE flag always indicates no redundancy should be worst case if we require "same" runs to be at least 3 long for 1-component IE case)
 
+/** Largest RLE size (as a fraction of the uncompressed size of the sample rows) for which eEncodingAuto chooses RLE */
+#define RLE_AUTO_MAX_RATIO   0.9
+
+/** Alignment (in bytes) of the start of each row of a frame buffer from HdrDpxFrameBufferPool */
+#define FRAME_BUFFER_ALIGNMENT   64
+
 /** Round an offset up to a 4-byte (DWORD) boundar */
 #define CEIL_DWORD(o)    (((o + 3)>>2)<<2)
 
+/** User identification string that marks a user-defined data section holding an RLE row index */
+#define RLE_ROW_INDEX_USERID    "HDRDPX RLE ROW INDEX"
+/** Layout version of the RLE row index (U32 version, U32 number of IEs, then per IE: U32 IE index, U32 data offset, U32 number of rows, U32 row offsets[rows]) */
+#define RLE_ROW_INDEX_VERSION   1
+
 #ifndef DPX_H
 
 #ifdef _MSC_VER
@@ -663,6 +674,7 @@ namespace Dpx {
 	enum HdrDpxEncoding {
 		eEncodingNoEncoding = 0,  ///< uncompressed (no encoding)
 		eEncodingRLE = 1,   ///< compressed using run-length encoding (RLE)
+		eEncodingAuto = 2,   ///< (writing only) RLE or uncompressed, chosen from sample rows when the file is opened for writing (see HdrDpxImageElement::AddEncodingSampleRow())
 		eEncodingUndefined = UINT16_MAX  ///< undefined encoding
 	};
 
@@ -923,6 +935,82 @@ namespace Dpx {
 
 
 namespace Dpx {
+	/** Datums stored for each pixel (or pixel pair) of a descriptor */
+	struct DescriptorDatums
+	{
+		uint8_t descriptor;   ///< descriptor code
+		uint8_t num_components;   ///< number of datums (0 if the descriptor is not known)
+		DatumLabel labels[8];   ///< datum labels, in the order they are stored
+	};
+
+	/** Compile-time table of the datums of each descriptor, grouped by descriptor range (see DescriptorTableIndex()) */
+	constexpr DescriptorDatums DESCRIPTOR_DATUMS[] =
+	{
+		{ eDescUser, 1, { DATUM_UNSPEC } },
+		{ eDescR, 1, { DATUM_R } },
+		{ eDescG, 1, { DATUM_G } },
+		{ eDescB, 1, { DATUM_B } },
+		{ eDescA, 1, { DATUM_A } },
+		{ 5, 0, { } },
+		{ eDescY, 1, { DATUM_Y } },
+		{ eDescCbCr, 2, { DATUM_CB, DATUM_CR } },
+		{ eDescZ, 1, { DATUM_Z } },
+		{ eDescComposite, 1, { DATUM_COMPOSITE } },
+		{ eDescCb, 1, { DATUM_CB } },
+		{ eDescCr, 1, { DATUM_CR } },
+		{ eDescRGB_268_1, 3, { DATUM_R, DATUM_G, DATUM_B } },
+		{ eDescRGBA_268_1, 4, { DATUM_R, DATUM_G, DATUM_B, DATUM_A } },
+		{ eDescABGR_268_1, 4, { DATUM_A, DATUM_B, DATUM_G, DATUM_R } },
+		{ eDescBGR, 3, { DATUM_B, DATUM_G, DATUM_R } },
+		{ eDescBGRA, 4, { DATUM_B, DATUM_G, DATUM_R, DATUM_A } },
+		{ eDescARGB, 4, { DATUM_A, DATUM_R, DATUM_G, DATUM_B } },
+		{ eDescRGB, 3, { DATUM_R, DATUM_G, DATUM_B } },
+		{ eDescRGBA, 4, { DATUM_R, DATUM_G, DATUM_B, DATUM_A } },
+		{ eDescABGR, 4, { DATUM_A, DATUM_B, DATUM_G, DATUM_R } },
+		{ eDescCbYCrY, 4, { DATUM_CB, DATUM_Y, DATUM_CR, DATUM_Y2 } },
+		{ eDescCbYACrYA, 6, { DATUM_CB, DATUM_Y, DATUM_A, DATUM_CR, DATUM_Y2, DATUM_A2 } },
+		{ eDescCbYCr, 3, { DATUM_CB, DATUM_Y, DATUM_CR } },
+		{ eDescCbYCrA, 4, { DATUM_CB, DATUM_Y, DATUM_CR, DATUM_A } },
+		{ eDescCYY, 3, { DATUM_C, DATUM_Y, DATUM_Y2 } },
+		{ eDescCYAYA, 5, { DATUM_C, DATUM_Y, DATUM_A, DATUM_Y2, DATUM_A2 } },
+		{ eDescGeneric2, 2, { DATUM_UNSPEC, DATUM_UNSPEC2 } },
+		{ eDescGeneric3, 3, { DATUM_UNSPEC, DATUM_UNSPEC2, DATUM_UNSPEC3 } },
+		{ eDescGeneric4, 4, { DATUM_UNSPEC, DATUM_UNSPEC2, DATUM_UNSPEC3, DATUM_UNSPEC4 } },
+		{ eDescGeneric5, 5, { DATUM_UNSPEC, DATUM_UNSPEC2, DATUM_UNSPEC3, DATUM_UNSPEC4, DATUM_UNSPEC5 } },
+		{ eDescGeneric6, 6, { DATUM_UNSPEC, DATUM_UNSPEC2, DATUM_UNSPEC3, DATUM_UNSPEC4, DATUM_UNSPEC5, DATUM_UNSPEC6 } },
+		{ eDescGeneric7, 7, { DATUM_UNSPEC, DATUM_UNSPEC2, DATUM_UNSPEC3, DATUM_UNSPEC4, DATUM_UNSPEC5, DATUM_UNSPEC6, DATUM_UNSPEC7 } },
+		{ eDescGeneric8, 8, { DATUM_UNSPEC, DATUM_UNSPEC2, DATUM_UNSPEC3, DATUM_UNSPEC4, DATUM_UNSPEC5, DATUM_UNSPEC6, DATUM_UNSPEC7, DATUM_UNSPEC8 } },
+		{ eDescUndefined, 0, { } }
+	};
+
+	/** Index of a descriptor in DESCRIPTOR_DATUMS
+		@param desc	Descriptor
+		@return		Table index (the last entry for descriptors that are not known) */
+	constexpr uint8_t DescriptorTableIndex(uint8_t desc)
+	{
+		return (desc <= eDescCr) ? desc :
+			(desc >= eDescRGB_268_1 && desc <= eDescABGR) ? 12 + (desc - eDescRGB_268_1) :
+			(desc >= eDescCbYCrY && desc <= eDescCYAYA) ? 21 + (desc - eDescCbYCrY) :
+			(desc >= eDescGeneric2 && desc <= eDescGeneric8) ? 27 + (desc - eDescGeneric2) :
+			(desc == eDescUndefined) ? 0 : 34;
+	}
+
+	/** Look up the datums of a descriptor (no allocation; can be evaluated at compile time)
+		@param desc	Descriptor
+		@return		Table entry for the descriptor (num_components is 0 if the descriptor is not known) */
+	constexpr const DescriptorDatums &GetDescriptorDatums(uint8_t desc)
+	{
+		return DESCRIPTOR_DATUMS[DescriptorTableIndex(desc)];
+	}
+
+	/** Number of datums stored per pixel (or pixel pair) for a descriptor
+		@param desc	Descriptor
+		@return		Number of datums (0 if the descriptor is not known) */
+	constexpr uint8_t DescriptorNumComponents(uint8_t desc)
+	{
+		return DESCRIPTOR_DATUMS[DescriptorTableIndex(desc)].num_components;
+	}
+
 	/** Convert a descriptor to a list (vector) of datum labels
 		@param desc	Descriptor
 		@return		Vector of datum labels
@@ -932,10 +1020,30 @@ namespace Dpx {
 	/** Convert a list (vector) of datum labels to a descriptor 
 		@param datum_list	Vector of datum labels
 		@return				Descriptor corresponding to datum label list, or 255 if no descriptor matches the list */
-	uint8_t DatumListToDescriptor(std::vector<DatumLabel> datum_list);
+	uint8_t DatumListToDescriptor(const std::vector<DatumLabel> &datum_list);
 
 	class HdrDpxFile;
 
+	/** Layout of an image element, derived from the header when the image element is opened (see HdrDpxImageElement::GetLayout()) */
+	struct HdrDpxImageElementLayout
+	{
+		uint32_t width = 0;   ///< width of the image element (in pixels)
+		uint32_t height = 0;   ///< height of the image element (in pixels)
+		uint8_t descriptor = UNDEFINED_U8;   ///< descriptor of the image element
+		bool is_h_subsampled = false;   ///< chroma is horizontally subsampled by 2
+		bool is_v_subsampled = false;   ///< chroma is vertically subsampled by 2
+		uint8_t num_components = 0;   ///< number of datums per pixel
+		std::vector<DatumLabel> datum_labels;   ///< datum labels, in the order they are stored
+		uint8_t bit_depth = 0;   ///< bits per datum
+		uint16_t packing = ePackingPacked;   ///< packing (selects the datum packing routine together with bit_depth and direction_r2l)
+		bool is_rle = false;   ///< image data is run-length encoded
+		bool direction_r2l = false;   ///< datums are stored right-to-left in each image data word
+		uint32_t row_size_datums = 0;   ///< datums per row
+		uint32_t row_size_bytes = 0;   ///< bytes per uncompressed row, excluding end-of-line padding
+		uint32_t row_stride_bytes = 0;   ///< bytes per uncompressed row, including end-of-line padding
+		uint32_t end_of_image_padding = 0;   ///< bytes of padding after the last row
+	};
+
 	/** Interface for handling a single image element within a DPX file
 	*
 	* A DPX file can contain up to 8 image elements, and each one containing image data is
@@ -959,6 +1067,17 @@ namespace Dpx {
 			@param row				row number to write
 			@param[in]	datum_ptr	pointer to buffer that contains a line's worth of samples to write */
 		void App2DpxPixels(uint32_t row, double *datum_ptr);
+		/** Write a block of consecutive rows of integer pixels. The rows are encoded in parallel into separate buffers, then written to the file in row order.
+			For RLE image elements, first_row must follow the last row written (as for App2DpxPixels()) unless RLE buffering is enabled.
+			@param first_row		first row number to write
+			@param num_rows			number of rows to write
+			@param[in]	datum_ptr	pointer to buffer that contains num_rows * GetRowSizeInDatums() samples
+			@param num_threads		number of threads to use for encoding (0 = number of hardware threads) */
+		void App2DpxPixelRows(uint32_t first_row, uint32_t num_rows, int32_t *datum_ptr, unsigned int num_threads = 0);
+		/** Provide a row of integer pixels used to decide whether an image element with eEncodingAuto is RLE coded. A few rows spread over the image are enough.
+			The row is copied, so it can be called with the same buffer each time. Image size, descriptor, bit depth and packing must be set first.
+			@param[in]	datum_ptr	pointer to buffer that contains a line's worth of samples */
+		void AddEncodingSampleRow(const int32_t *datum_ptr);
 
 		/** Set a U32 header field to a specific value
 			@param field			field to write to 
@@ -1082,6 +1201,9 @@ namespace Dpx {
 		/** Get the number of components based on the descriptor
 			@return					number of components */
 		uint8_t GetNumberOfComponents(void) const;
+		/** Get the layout computed when the image element was opened (width, row sizes, datum labels, etc.)
+			@return					layout of the image element */
+		const HdrDpxImageElementLayout &GetLayout(void) const;
 		/** Convert a datum label to a printable string
 			@return					string description of datum label */
 		std::string DatumLabelToName(Dpx::DatumLabel datum_label) const;
@@ -1091,41 +1213,93 @@ namespace Dpx {
 		HdrDpxImageElement();
 		friend class HdrDpxFile;
 		///////////////////////////////////////// called from HdrDpxFile class:
-		HdrDpxImageElement(uint8_t ie_idx, std::fstream *fstream_ptr, HDRDPXFILEFORMAT *dpxf_ptr, FileMap *file_map_ptr);
+		HdrDpxImageElement(uint8_t ie_idx, std::iostream *fstream_ptr, HDRDPXFILEFORMAT *dpxf_ptr, FileMap *file_map_ptr);
 		/** Initializes the IE if the blank constructor was used
 			@param[in] ie_idx		Index number (0-7) of the image element in the file
-			@param[in] fstream_ptr	Pointer to the open fstream for accessing the DPX file
+			@param[in] fstream_ptr	Pointer to the open stream for accessing the DPX file
 			@param[in] dpxf_ptr		Pointer to the header structure for the DPX file
 			@param[in] file_map_ptr	Pointer to the file map for the DPX file */
-		void Initialize(uint8_t ie_idx, std::fstream *fstream_ptr, HDRDPXFILEFORMAT *dpxie_ptr, FileMap *file_map_ptr);
+		void Initialize(uint8_t ie_idx, std::iostream *fstream_ptr, HDRDPXFILEFORMAT *dpxie_ptr, FileMap *file_map_ptr);
 		/** Deinitialize the IE */
 		void Deinitialize();
 		/** Lock the header so it can't be modified */
 		void LockHeader();
 		/** Unlock the header so it can be modified */
 		void UnlockHeader();
+		/** Log a warning if the fields that set the data layout are locked (the header is being updated in place)
+			@return					true if the field must not be changed */
+		bool RefuseLayoutChange();
 		/** Call if file is open for reading */
 		void OpenForReading(bool bswap);
+		/** Reopen for reading a new file whose header has the same layout as the one last opened, keeping the cached layout and buffers
+			@param bswap			flag indicating whether byte swap is needed
+			@return					false (and nothing is changed) if the layout differs or was never computed */
+		bool ReopenForReading(bool bswap);
+		/** Check whether the header fields that determine the layout match the cached layout */
+		bool LayoutMatchesHeader(void) const;
+		/** Point the IE at the stream, header and file map of another HdrDpxFile object (after a move) */
+		void Rebind(std::iostream *fstream_ptr, HDRDPXFILEFORMAT *dpxf_ptr, FileMap *file_map_ptr);
+		/** Image elements are moved (never copied) along with the HdrDpxFile object that owns them */
+		HdrDpxImageElement &operator=(HdrDpxImageElement &&) = default;
 		/** Call if file is open for writing */
 		void OpenForWriting(bool bswap);
 
+		/** Source samples and output buffer for encoding a single row, so that rows can be encoded independently of the file stream */
+		struct RowEncoder
+		{
+			RowEncoder() : fifo(16) {}
+			const int32_t *int_row = NULL;  //!< pointer to integer pixel data
+			const float *float_row = NULL;  //!< pointer to floating point pixel data
+			const double *double_row = NULL;  //!< pointer to double precision pixel data
+			Fifo fifo;   //!< FIFO object
+			std::vector<uint32_t> words;   //!< encoded image data words (in file byte order)
+			uint8_t *out = NULL;   //!< if set, encoded words are stored here (e.g., in a memory-mapped file) instead of in words
+			std::vector<uint32_t> run_cost;   //!< size-optimal RLE: fewest datums needed to encode the rest of the row from each pixel
+			std::vector<uint32_t> run_choice;   //!< size-optimal RLE: chosen run from each pixel ((length << 1) | same flag)
+			std::vector<uint32_t> run_window;   //!< size-optimal RLE: candidate ends of a different-pixel run (sliding window minimum)
+		};
+
 		// Internal functions
 		/** Write a single pixel to a Fifo 
+			@param enc				Row encoder
 			@param xpos				Pixel x position within line */
-		void WritePixel(uint32_t xpos);
+		void WritePixel(RowEncoder &enc, uint32_t xpos) const;
 		/** Write a single datum value to a Fifo 
+			@param enc				Row encoder
 			@param datum			Datum value to write */
-		void WriteDatum(int32_t datum);
-		/** Finish writing any data still left in FIFO */
-		void WriteFlush();
+		void WriteDatum(RowEncoder &enc, int32_t datum) const;
+		/** Move any complete image data words from the FIFO to the row buffer */
+		void WriteFlush(RowEncoder &enc) const;
 		/** Finish writing a line, performing any necessary padding */
-		void WriteLineEnd();
-		/** Function to determine if next pixel is the same (for RLE) 
-			@param xpos				X position within line
-			@param pixel			Pixel value to match */
-		bool IsNextSame(uint32_t xpos, int32_t pixel[]);
-		/** Compute the width and height values from the header info */
-		void ComputeWidthAndHeight(void);
+		void WriteLineEnd(RowEncoder &enc) const;
+		/** Find the RLE run that starts at a pixel (each pixel is compared with its neighbour once)
+			@param enc				Row encoder
+			@param xpos				X position of the first pixel of the run
+			@param[out] same		true for a run of identical pixels, false for a run of different pixels
+			@return					run length in pixels */
+		uint32_t ScanRun(const RowEncoder &enc, uint32_t xpos, bool &same) const;
+		/** RLE encode one row choosing the run boundaries that give the fewest datums (and hence the smallest row)
+			@param enc				Row encoder with source row pointer set */
+		void EncodeRowOptimalRLE(RowEncoder &enc) const;
+		/** Resolve eEncodingAuto to eEncodingRLE or eEncodingNoEncoding by RLE coding the sample rows, then discard the samples */
+		void ChooseEncoding(void);
+		/** Encode (and RLE compress, if enabled) one row of samples into the encoder's word buffer. Does not access the file.
+			@param enc				Row encoder with source row pointer set */
+		void EncodeRow(RowEncoder &enc) const;
+		/** Returns true if rows are packed straight into a memory-mapped output file rather than written through the file stream */
+		bool IsWrittenToMapping(void) const;
+		/** Write an encoded row to the file and update the RLE row offsets and file map
+			@param row				row number
+			@param words			encoded image data words */
+		void WriteEncodedRow(uint32_t row, const std::vector<uint32_t> &words);
+		/** Write the end-of-image padding at the current position of the file stream (after the last row) */
+		void WriteEndOfImagePadding();
+		/** Returns the number of bytes of buffered RLE image data (including end-of-image padding) */
+		uint32_t GetBufferedRLESize() const;
+		/** Write the buffered RLE rows to the file starting at the image element data offset, then release the buffers */
+		void WriteBufferedRLERows();
+		/** Compute the image element layout (width, height, components, row sizes) from the header info */
+		void ComputeLayout(void);
 
 		/** Reset any accumulated warning messages */
 		void ResetWarnings(void);
@@ -1134,7 +1308,7 @@ namespace Dpx {
 		// Pointers back to HdrDpxFile
 		HDRDPXFILEFORMAT *m_dpx_hdr_ptr; //!< Pointer to main DPX file data structure
 		HDRDPX_IMAGEELEMENT *m_dpx_ie_ptr;  //!< Pointer to IE data structure
-		std::fstream *m_filestream_ptr;  //!< Pointer to file stream in HdrDpx object
+		std::iostream *m_filestream_ptr;  //!< Pointer to file stream in HdrDpx object
 		FileMap *m_file_map_ptr;   //!< Pointer to file map in HdrDpx object
 
 		uint32_t GetOffsetForRow(uint32_t row) const; //!< Return file offset (seek pointer) for specific row
@@ -1142,13 +1316,13 @@ namespace Dpx {
 		void WriteRow(uint32_t row);  //!< Write the row to a file
 		uint32_t BytesUsed(void);   //!< Returns the number of bytes used for the IE
 		
-		uint32_t m_width;  //!< width of IE (in pixels)
-		uint32_t m_height;  //!< height of IE (in pixels)
+		HdrDpxImageElementLayout m_layout;  //!< geometry and packing of the IE (computed from the header)
+		bool m_has_layout = false;  //!< flag indicating m_layout has been computed
 		bool m_byte_swap;   //!< flag indicating whether byte swap is needed
-		bool m_direction_r2l;   //!< 0 = left-to-right datum order, 1 = right-to-left datum order
 		std::list<std::string> m_warnings;   //!< List of warning mesages
 		ErrorObject m_err;   //!< Error object (for tracking errors)
-		Fifo m_fifo;   //!< FIFO object
+		RowEncoder m_row_encoder;   //!< encoder used for rows written one at a time
+		Fifo m_read_fifo = Fifo(16);   //!< FIFO used to unpack rows as they are read (kept so reading a row does not allocate)
 
 		uint8_t m_ie_index = 0xff;  //!< indicates which IE index corresponds to this IE
 		float *m_float_row;  //!< pointer to floating point pixel data
@@ -1158,11 +1332,17 @@ namespace Dpx {
 		bool m_is_open_for_write;  //!< flag indicating if file is open for writing
 		bool m_is_open_for_read;  //!< flag indicating if file is open for reading
 		bool m_is_header_locked = false;  //!< flag indicating header is locked
+		bool m_is_layout_locked = false;  //!< flag indicating the fields that set the data layout are locked (header updated in place)
 		bool m_isinitialized = false;  //!< flag indicating whether header is initialized
 		uint32_t m_previous_row;   //!< which row was last read
 		uint32_t m_previous_file_offset;  //!< keeps track of where we're reading for IE in case another IE is read and changes seek position
-		bool m_is_h_subsampled;  //!< flag indicating if chroma is horizontally subsampled by 2
-		bool m_is_v_subsampled;  //!< Flag indicating if chroma is vertically subsampled by 2
+		std::vector<uint32_t> m_rle_row_offsets;  //!< file offset of the start of each RLE row (UNDEFINED_U32 until known)
+		bool m_buffer_rle_rows = false;  //!< flag indicating encoded RLE rows are held in memory until the file is closed
+		bool m_optimal_rle = false;  //!< flag indicating RLE run boundaries are chosen to minimize the encoded size
+		uint8_t *m_mapped_data = NULL;  //!< start of the memory-mapped output file (NULL if not mapped); uncompressed rows are packed straight into it
+		std::vector<int32_t> m_encoding_samples;  //!< sample rows used to choose the encoding of an eEncodingAuto image element
+		uint32_t m_num_encoding_samples = 0;  //!< number of rows in m_encoding_samples
+		std::vector<std::vector<uint32_t>> m_rle_row_buffers;  //!< encoded rows of a buffered RLE image element
 
 		bool m_warn_unexpected_nonzero_data_bits;  //!< flag indicating unexepected nonzero data bits were encountered
 		uint32_t m_warn_image_data_word_mask;  //!< indicates which bit positions unexpected nonzero data bits were found in
@@ -1171,7 +1351,98 @@ namespace Dpx {
 		bool m_warn_zero_run_length;  //!< flag indicating a zero run length was signaled
 	};
 
+	/** Application-side pixel storage for one image element, borrowed from an HdrDpxFrameBufferPool
+	*
+	* Rows hold datums in the format used by Dpx2AppPixels() and App2DpxPixels() (int32_t, or float/double for 32/64-bit
+	* image elements). Each row starts on a FRAME_BUFFER_ALIGNMENT byte boundary.
+	*/
+	class HdrDpxFrameBuffer
+	{
+	public:
+		/** Get a pointer to the start of a row
+			@param row			Row number
+			@return				Pointer to the first datum of the row */
+		template <typename T> T *GetRow(uint32_t row) const
+		{
+			return reinterpret_cast<T *>(m_data + static_cast<size_t>(row) * m_row_stride);
+		}
+		uint32_t GetHeight(void) const;  //!< Number of rows
+		uint32_t GetRowSizeInDatums(void) const;  //!< Number of datums in each row
+		size_t GetRowStride(void) const;  //!< Distance between the start of consecutive rows (in bytes)
+
+	private:
+		friend class HdrDpxFrameBufferPool;
+		std::unique_ptr<uint8_t[]> m_storage;  //!< allocated memory (including room for alignment)
+		size_t m_capacity = 0;  //!< usable bytes after the aligned start
+		uint8_t *m_data = NULL;  //!< aligned start of the first row
+		size_t m_row_stride = 0;  //!< bytes from the start of one row to the start of the next
+		uint32_t m_height = 0;  //!< number of rows in the current layout
+		uint32_t m_row_size_datums = 0;  //!< datums per row in the current layout
+		bool m_in_use = false;  //!< flag indicating the buffer is borrowed
+	};
+
+	/** Pool of reusable frame buffers for reading or writing sequences of similarly formatted frames
+	*
+	* Buffers are sized from an image element layout (see HdrDpxImageElement::GetLayout()). A returned buffer is handed out
+	* again for any layout that fits in it, so once the pool holds enough buffers, borrowing does not allocate.
+	* The pool is not thread safe.
+	*/
+	class HdrDpxFrameBufferPool
+	{
+	public:
+		/** Borrow a buffer large enough for a frame of an image element
+			@param layout		Layout of the image element
+			@return				Buffer, which stays valid until it is returned or the pool is destroyed */
+		HdrDpxFrameBuffer *Borrow(const HdrDpxImageElementLayout &layout);
+		/** Hand a borrowed buffer back to the pool
+			@param buffer		Buffer returned by Borrow() */
+		void Return(HdrDpxFrameBuffer *buffer);
+		/** Allocate buffers ahead of time so that the first frames of a sequence do not allocate
+			@param layout		Layout of the image element
+			@param count		Number of free buffers the pool should hold for this layout */
+		void Reserve(const HdrDpxImageElementLayout &layout, unsigned int count);
+		/** Free all buffers that are not borrowed */
+		void Trim(void);
+		unsigned int GetNumBuffers(void) const;  //!< Number of buffers owned by the pool (borrowed or free)
+
+	private:
+		/** Add a new free buffer to the pool
+			@param capacity		Usable size of the buffer (in bytes)
+			@return				Pointer to the new buffer */
+		HdrDpxFrameBuffer *Allocate(size_t capacity);
+		std::vector<std::unique_ptr<HdrDpxFrameBuffer>> m_buffers;  //!< all buffers owned by the pool
+	};
+
+	/** Random-access byte source or sink supplied by the application, e.g., to read or write DPX files held in shared memory
+	*
+	* Offsets are from the start of the DPX file. An object used for reading only needs to implement Read() and GetSize(), and
+	* one used for writing only needs Write() and GetSize(). The object must stay valid until HdrDpxFile::Close() is called.
+	*/
+	class HdrDpxRandomAccessIO
+	{
+	public:
+		virtual ~HdrDpxRandomAccessIO() {}
+		/** Read bytes from the source
+			@param offset			byte offset to read from
+			@param[out] data		buffer to read into
+			@param size				number of bytes to read
+			@return					number of bytes read (less than size at the end of the source) */
+		virtual size_t Read(uint64_t offset, void *data, size_t size) { return 0; }
+		/** Write bytes to the sink, extending it if needed
+			@param offset			byte offset to write to
+			@param data				bytes to write
+			@param size				number of bytes to write
+			@return					number of bytes written */
+		virtual size_t Write(uint64_t offset, const void *data, size_t size) { return 0; }
+		/** Returns the current size of the source or sink in bytes */
+		virtual uint64_t GetSize() = 0;
+	};
+
 	/** Main interface for reading or writing a DPX file
+
+		The user data and standards-based metadata of a file being read are loaded when they are first accessed, which can
+		happen in const getters such as GetUserData(), GetHeader(eUserDefinedData) and DumpHeader(). Those getters are
+		therefore not thread-safe, even on an object that is only read. Close() loads any section not accessed yet.
 	*/
 	class HdrDpxFile
 	{
@@ -1182,6 +1453,15 @@ namespace Dpx {
 			@param filename			Filename of DPX file to read */
 		HdrDpxFile(std::string filename);			// Shortcut to open a file for reading
 		~HdrDpxFile();
+		/** Move constructor. An open file stays open and is now accessed through the new object.
+			@param other			object to move from (left closed, with a cleared header) */
+		HdrDpxFile(HdrDpxFile &&other);
+		/** Move assignment. Any file open in this object is closed first.
+			@param other			object to move from (left closed, with a cleared header)
+			@return					this object */
+		HdrDpxFile &operator=(HdrDpxFile &&other);
+		HdrDpxFile(const HdrDpxFile &) = delete;
+		HdrDpxFile &operator=(const HdrDpxFile &) = delete;
 		/** Overload of << that allows DPX header information to be dumped to specified ostream (e.g., cout << dpxfileobject) */
 		friend std::ostream& operator<<(std::ostream & os, const HdrDpxFile &dpxf)
 		{
@@ -1191,11 +1471,82 @@ namespace Dpx {
 		/** Open the specified DPX file for reading. Do not call this if the filename was passed to the constructor already 
 			@param filename			Filename of DPX file to read */
 		void OpenForReading(std::string filename);
+		/** Read a DPX file held in memory. Rows are read straight from the buffer (it is not copied), so the buffer must stay
+			valid and unchanged until Close() is called.
+			@param data				Start of the DPX file
+			@param size				Size of the DPX file in bytes */
+		void OpenForReading(const uint8_t *data, size_t size);
+		/** Read a DPX file through an application-supplied interface
+			@param io				Source to read from (must stay valid until Close() is called) */
+		void OpenForReading(HdrDpxRandomAccessIO *io);
+		/** Read a DPX file from a forward-only input such as a pipe or standard input. The input is never seeked: each section is
+			read when it is requested, and anything passed over to reach it (e.g., the user data when the first row is read) is
+			buffered in memory. Reading image elements, user data and metadata in file order therefore buffers nothing. When the
+			file is closed, the input is left at the end of the file (as given by its file size header field), so DPX files sent
+			back to back can be read by opening the same input again.
+			@param is				Input to read from (must stay valid until Close() is called) */
+		void OpenForReading(std::istream &is);
+		/** Close the current file (if any) and open another DPX file for reading, e.g., the next frame of a sequence.
+			Image elements whose layout matches the previous file keep their cached layout and buffers.
+			@param filename			Filename of DPX file to read */
+		void Reopen(std::string filename);
+		/** Read only the 2048-byte header of a DPX file, e.g., to catalog many files. The header is fetched with a single read and
+			the file is closed again before returning. User data and standards-based metadata are not read and image elements are
+			not opened, so only the header fields can be queried (and validated) afterwards.
+			@param filename			Filename of DPX file to probe */
+		void Probe(std::string filename);
+		/** Close the current file (if any) and open another DPX file for writing, e.g., the next frame of a sequence.
+			If the ditto key is set to eDittoKeySame and a frame has already been written, the header of the previous frame is
+			reused as-is (only the frame position and time code are taken from the current header), so core field defaults and
+			data offsets are not recomputed.
+			@param filename			Filename of DPX file to write */
+		void ReopenForWriting(std::string filename);
+		/** Open a DPX file to change its header in place, e.g., to correct a time code or add metadata, without rewriting the
+			image data. Header fields are set with SetHeader() as for a file being written, except that the fields that locate or
+			lay out the image data (offsets, image size, number of image elements, datum mapping direction, byte order, and the
+			descriptor, bit depth, packing, encoding and padding of each image element) cannot be changed. Close() rewrites only
+			the 2048-byte header, plus the user data and standards-based metadata if they were set and still fit: user data must
+			fit before the section that follows it, and metadata must fit before the next section unless it is at the end of the
+			file (metadata added to a file without any is appended). Sections that do not fit are left unchanged with a warning.
+			Rows can still be read while the file is open.
+			@param filename			Filename of DPX file to update */
+		void OpenForHeaderUpdate(std::string filename);
+		/** Write a copy of the file open for reading in another byte order, without decoding any pixels. Byte order only affects
+			the header fields and the 32-bit words that hold the image data, so the header is rewritten, each image data word
+			(and each word of an RLE row index) is byte swapped, and everything else is copied as is.
+			@param filename			Filename of DPX file to write
+			@param byte_order		Byte order of the copy */
+		void ConvertByteOrder(std::string filename, HdrDpxByteOrder byte_order);
+		/** Copy the image data of an image element of another file without decoding it, e.g., when only header fields change or
+			an image element is dropped. Both image elements must have the same layout (descriptor, bit depth, packing, size,
+			datum mapping direction and byte order) and must not be run-length encoded. Where the filesystem supports it, the data is
+			copied by the kernel (copy_file_range() on Linux, which can share the blocks of a reflink-capable filesystem rather than
+			copying them); otherwise it is copied in large chunks. Must be called after OpenForWriting(), in place of writing the rows.
+			@param src_file			File open for reading that holds the image element to copy
+			@param src_ie			Index of the image element in src_file
+			@param dst_ie			Index of the image element in this file
+			@return					true if the data was copied; false if it was not (the reason is logged), so the rows must be copied as pixels */
+		bool CopyImageElementRaw(HdrDpxFile &src_file, uint8_t src_ie, uint8_t dst_ie);
 		/** Close the DPX file */
 		void Close();
 		/** Open the specified DPX file for writing. 
 		    @param filename			Filename of DPX file to write */
 		void OpenForWriting(std::string filename);
+		/** Write the DPX file to memory. The buffer is cleared, and holds the complete file once Close() has been called.
+			@param buffer			Buffer to write to (must stay valid until Close() is called) */
+		void OpenForWriting(std::vector<uint8_t> &buffer);
+		/** Write the DPX file through an application-supplied interface
+			@param io				Sink to write to (must stay valid until Close() is called) */
+		void OpenForWriting(HdrDpxRandomAccessIO *io);
+		/** Write the DPX file to a forward-only output such as a pipe or standard output. The output is never seeked: the complete
+			header (including the file size), the user data and the standards-based metadata are written when the file is opened,
+			and the image data is written in offset order. Rows written ahead of the next offset to be written (e.g., when rows or image elements are
+			not written in file order) are buffered in memory until the data before them has been written, and any data not
+			written by the time Close() is called is filled with zeros. Because nothing can be filled in afterwards, image
+			elements must not be run-length encoded (including eEncodingAuto settling on RLE) and the standards-based metadata
+			offset must not be eSBMAutoLocate.
+			@param os				Output to write to (must stay valid until Close() is called) */
+		void OpenForWriting(std::ostream &os);
 		/** Dump the DPX header information to a string 
 		    @return					string containing DPX header information */
 		std::string DumpHeader() const;
@@ -1224,6 +1575,39 @@ namespace Dpx {
 		void DumpUserDataOptions(bool dump_ud, HdrDpxDumpFormat format = eDumpFormatDefault);
 		/*** Indicate whether standards-based metadata is dumped with header dump (default no) and if dumped as bytes or strings */
 		void DumpStandardsBasedMetedataOptions(bool dump_sbmd, HdrDpxDumpFormat format = eDumpFormatDefault);
+		/** Store the start offset of every row of each RLE image element in the user-defined data section when the file is written (default off).
+			The index is only written if the user-defined data section is not otherwise used. Must be called before OpenForWriting().
+			@param enable			true to write the RLE row index */
+		void EnableRLERowIndex(bool enable = true);
+		/** Returns true if the file being read contains a valid RLE row index, in which case rows of RLE image elements can be read in any order */
+		bool HasRLERowIndex() const;
+		/** Hold the encoded rows of RLE image elements in memory and lay them out contiguously, with exact offsets, when Close() is called (default off).
+			Rows of RLE image elements can then be written in any order, and the image elements can be written in any order or interleaved.
+			Must be called before OpenForWriting().
+			@param enable			true to buffer RLE image elements */
+		void EnableRLEBuffering(bool enable = true);
+		/** Choose RLE run boundaries that minimize the size of each encoded row instead of using the default greedy encoder (default off).
+			Rows are still decoded by any RLE reader. Must be called before OpenForWriting().
+			@param enable			true for size-optimal RLE encoding */
+		void EnableSizeOptimalRLE(bool enable = true);
+		/** Write files opened by name through a memory mapping of the output file (default off). The file is created at its final
+			size when it is opened, rows of uncompressed image elements are packed straight into the mapping, and the header is
+			written into the mapping when Close() is called. Files whose size is only known once they are written (RLE image
+			elements or auto-located standards-based metadata), or that cannot be mapped, are written through the file stream
+			as usual. Must be called before OpenForWriting().
+			@param enable			true to write through a memory mapping */
+		void EnableMappedWriting(bool enable = true);
+		/** Align the data offset of each image element placed when the file is opened for writing (i.e., whose offset to data is not
+			set) to a multiple of alignment bytes, e.g., 4096 so that the image data can be read with direct I/O or mapped with large
+			pages (default 1, no alignment). Must be called before OpenForWriting().
+			@param alignment		alignment in bytes (1, or a multiple of 4)
+			@param align_rows		if true, uncompressed image elements whose end-of-line padding is not set are padded so that every row starts on an alignment boundary */
+		void SetDataAlignment(uint32_t alignment, bool align_rows = false);
+		/** Allocate disk space for the whole file when it is opened for writing (default off), so the file is not fragmented as it is
+			written. Only files whose size is known when they are opened (no RLE image elements or auto-located standards-based metadata)
+			are preallocated, and the size of the file still only grows as data is written. Must be called before OpenForWriting().
+			@param enable			true to preallocate files */
+		void EnablePreallocation(bool enable = true);
 
 		/** Gets the value of a string header field
 			@param field			which header field to get
@@ -1386,16 +1770,75 @@ namespace Dpx {
 		/** Clear header or just IE data structure
 			@param ie_index				IE index (if specified, only clears the corresponding IE header; if unspecified, clears the entire DPX header) */
 		void ClearHeader(uint8_t ie_index = 0xff);
+		/** Open a DPX file for reading
+			@param filename				Filename of DPX file to read
+			@param reuse_layout			If true, image elements whose layout is unchanged are reopened without being reinitialized */
+		void OpenForReading(std::string filename, bool reuse_layout);
+		/** Read the header and open the image elements once m_stream is ready
+			@param reuse_layout			If true, image elements whose layout is unchanged are reopened without being reinitialized */
+		void OpenStreamForReading(bool reuse_layout);
+		/** Open a DPX file for writing
+			@param filename				Filename of DPX file to write
+			@param use_ditto_template	If true and the ditto key is eDittoKeySame, the header written for the previous frame is reused */
+		void OpenForWriting(std::string filename, bool use_ditto_template);
+		/** Set up the header and image elements for writing once m_stream is ready
+			@param use_ditto_template	If true and the ditto key is eDittoKeySame, the header written for the previous frame is reused
+			@param forward_only			If true, the header and user data are written immediately and never rewritten */
+		void OpenStreamForWriting(bool use_ditto_template, bool forward_only = false);
+		/** Read from or write to an application buffer or interface instead of a file
+			@param buf					Stream buffer giving access to the data
+			@param name					Name used in messages in place of a filename */
+		void UseStreamBuffer(std::streambuf *buf, std::string name);
+		/** Copy the frame position, time code and data offsets of a newly read header over the previous header
+			@param raw_header			Header as read from the file
+			@param byte_swap			true if the file byte order differs from the machine byte order */
+		void PatchDittoHeader(const HDRDPXFILEFORMAT &raw_header, bool byte_swap);
+		void ValidateFrameFields();   ///< Validate the header fields that may change from frame to frame
+		bool DittoTemplateFits() const;   ///< Returns true if the layout of the header matches the previous frame written, so the template can be used
+		bool HeaderEditedSinceDitto() const;   ///< Returns true if fields other than the frame position and time code changed since the previous frame written
+		void ResetDittoLayout();   ///< Undo the offsets filled in for the previous frame so a frame that does not fit the template is laid out again
 
 		HdrDpxImageElement m_IE[8];  ///< Array of image element objects
 		void ByteSwapHeader(void);   ///< Byte swap the header fields
 		void ByteSwapSbmHeader(void);   ///< Byte swap the standards-based metadata fields
 		bool ByteSwapToMachine(void);   ///< Byte swap the header (if needed) to match machine endianness
+		void CorrectLegacyDataOffsets(void);   ///< Undo the byte-reversed data offsets of files written by earlier versions
 		void ComputeOffsets();   ///< Compute offsets to data for writing file
 		void FillCoreFields();   ///< Fill in any missing core fields
 
-		void ReadUserData();    ///< Read the user data from the file
-		void ReadSbmData();    ///< Read the standards-based metadata from the file
+		void ReadUserData(std::istream &is) const;    ///< Read the user data from the file
+		void ReadSbmData(std::istream &is) const;    ///< Read the standards-based metadata from the file
+		void ReadSection(void (HdrDpxFile::*read_fn)(std::istream &) const) const;   ///< Call a section read function on the open file
+		void DiscardPendingSections();   ///< Forget the sections not loaded yet, before closing a file whose sections are about to be replaced
+		void LoadUserData() const;   ///< Read the user data if the file was opened but it has not been accessed yet
+		void LoadSbmData() const;   ///< Read the standards-based metadata if the file was opened but it has not been accessed yet
+		void WriteUserData();    ///< Write the user data section to the file
+		void WriteHeader();    ///< Write the header to the start of the file (in the file byte order)
+		void WriteSbmData();    ///< Write the standards-based metadata section to the file (if present)
+		/** Set the file size field from the layout, for outputs whose size must be known before anything is written
+			@param[out] reason			why the size is not known in advance (if false is returned)
+			@return						true if the layout does not depend on the data written */
+		bool ComputeFixedFileSize(std::string &reason);
+		/** Create the output file at its final size and map it into memory in place of the file stream
+			@return						start of the mapped file, or NULL if the file is written through the file stream */
+		uint8_t *MapOutputFile();
+		void PreallocateOutputFile();   ///< Allocate disk space for the file being written (if its size is known)
+		void WriteLayoutGaps();   ///< Write zeros to the space between the sections of the file
+		bool RefuseLayoutChange();   ///< Log a warning and return true if the header is being updated in place (so layout fields are locked)
+		/** Find the start of the next section (image data or metadata) of a file that was read
+			@param offset				first offset at which a section is looked for
+			@return						start of the first section at or after offset, or UINT64_MAX if there is none */
+		uint64_t NextSectionStart(uint64_t offset) const;
+		/** Write zeros over part of the file
+			@param start				first byte to clear
+			@param end					end of the range to clear (exclusive) */
+		void WriteZeros(uint64_t start, uint64_t end);
+		void WriteHeaderUpdate();   ///< Write the header of a file opened for header update, plus the user data and metadata if they were set
+		void PrepareRLERowIndex();   ///< Reserve user data space for the RLE row index (if enabled)
+		void EncodeRLERowIndex();   ///< Serialize the RLE row offsets into the user data
+		bool DecodeRLERowIndex();   ///< Validate the RLE row index in the user data and pass the row offsets to the image elements
+		bool IsByteSwapNeeded() const;   ///< Returns true if the file byte order differs from the machine byte order
+		void WriteBufferedRLEImageElements();   ///< Assign data offsets to buffered RLE image elements and write them to the file
 
 		std::list<std::string> m_warn_messages;  ///< list of warnings
 		std::string m_file_name;      ///< File name
@@ -1406,18 +1849,205 @@ namespace Dpx {
 		bool m_open_for_read = false;   ///< Flag indicating file is open for reading
 		bool m_is_header_locked = false;   ///< Flag indicating header is locked
 		std::fstream m_file_stream;    ///< File stream handle
+		std::unique_ptr<HdrDpxRandomAccessIO> m_owned_io;   ///< Interface created for a memory buffer being written or a forward-only input
+		std::unique_ptr<std::streambuf> m_stream_buf;   ///< Stream buffer over a memory buffer or application interface
+		std::unique_ptr<std::iostream> m_buf_stream;   ///< Stream reading or writing through m_stream_buf
+		std::iostream *m_stream = &m_file_stream;   ///< Stream being read or written (m_file_stream or m_buf_stream)
+		bool m_forward_only = false;   ///< Flag indicating the file is being written to a forward-only output
+		bool m_mapped_writing = false;   ///< indicates whether files opened by name are written through a memory mapping
+		uint32_t m_data_alignment = 1;   ///< alignment (in bytes) of the data offsets of image elements placed when writing
+		bool m_align_rows = false;   ///< indicates whether rows are padded to the data alignment when the end-of-line padding is not set
+		bool m_preallocate = false;   ///< indicates whether disk space for the whole file is allocated when it is opened for writing
+		bool m_header_update = false;   ///< Flag indicating the file was opened with OpenForHeaderUpdate()
+		bool m_userdata_changed = false;   ///< Flag indicating the user data was set after the file was opened
+		bool m_sbmdata_changed = false;   ///< Flag indicating the standards-based metadata was set after the file was opened
+		uint32_t m_update_user_size = 0;   ///< Size of the user data section (including the user ID) when opened for header update
+		uint64_t m_update_sbm_size = 0;   ///< Size of the metadata section (including descriptor and length) when opened for header update, 0 if none
 		bool m_ud_dump = false;    ///< indicates whether to dump user data with header
 		HdrDpxDumpFormat m_ud_dump_format = eDumpFormatDefault; ///< user data dump format
 		bool m_sbm_dump = false;    ///< indicates whether to dump standards-based metadata with header
 		HdrDpxDumpFormat m_sbm_dump_format = eDumpFormatDefault; ///< user data dump format
+		bool m_write_rle_row_index = false;   ///< indicates whether an RLE row index is stored in the user data when writing
+		bool m_has_rle_row_index = false;   ///< Flag indicating a valid RLE row index was read from the file
+		bool m_buffer_rle = false;   ///< indicates whether RLE image elements are buffered in memory until the file is closed
+		bool m_optimal_rle = false;   ///< indicates whether RLE image elements are encoded with the size-optimal encoder
 
 		HdrDpxByteOrder m_byteorder = eNativeByteOrder;  ///< Byte order of file
 		HDRDPXFILEFORMAT m_dpx_header;   ///< DPX header
-		HDRDPXSBMDATA m_dpx_sbmdata;    ///< Standards-based metadata structure
-		HDRDPXUSERDATA m_dpx_userdata;   ///< User data header
+		mutable HDRDPXSBMDATA m_dpx_sbmdata;    ///< Standards-based metadata structure (loaded on first access)
+		mutable HDRDPXUSERDATA m_dpx_userdata;   ///< User data header (loaded on first access)
+		mutable bool m_userdata_pending = false;   ///< Flag indicating the user data of the file read has not been loaded yet
+		mutable bool m_sbmdata_pending = false;   ///< Flag indicating the standards-based metadata of the file read has not been loaded yet
 		FileMap m_filemap;    ///< File map object
+		bool m_has_read_header = false;   ///< Flag indicating the header holds the last file read, which the next file can ditto
+		bool m_header_is_ditto = false;   ///< Flag indicating the header was carried over from the previous frame per the ditto key
+		bool m_has_ditto_template = false;   ///< Flag indicating a header template was saved when the previous frame was written
+		uint8_t m_ditto_ie_mask = 0;   ///< Image elements present in the header template (bit n = IE n)
+		HDRDPXFILEFORMAT m_ditto_template;   ///< Header of the previous frame written, after core fields and offsets were filled in
+		FileMap m_ditto_filemap;   ///< File map of the previous frame written
+		HDRDPXFILEFORMAT m_ditto_requested;   ///< Header of the template frame as specified, before core fields and offsets were filled in
+		HDRDPXFILEFORMAT m_ditto_previous;   ///< Header of the previous frame written, as it was when the file was closed
+		uint32_t m_ditto_sbm_length = 0;   ///< Standards-based metadata length of the previous frame written
+		bool m_has_ditto_validation = false;   ///< Flag indicating m_ditto_validation holds the result of validating the current header
+		ErrorObject m_ditto_validation;   ///< Messages from validating the fields a ditto frame shares with the previous frame
+
+		mutable ErrorObject m_err;   ///< Error tracking object (also written when a section is loaded on first access)
+	};
+
+	/** Read-only view of a DPX header held in a caller-owned buffer (e.g. a memory-mapped file or a network packet)
+	*
+	* Nothing is copied or byte-swapped up front: each field is read from the buffer and converted to machine byte order
+	* when it is requested, so constructing a view costs a few comparisons. The buffer must stay valid for the lifetime of
+	* the view. The user-defined data and standards-based metadata sections are only available if the buffer extends to
+	* cover them.
+	*/
+	class HdrDpxHeaderView
+	{
+	public:
+		/** Constructor
+			@param data				start of the DPX file (or at least its first 2048 bytes)
+			@param size				number of bytes available at data */
+		HdrDpxHeaderView(const uint8_t *data, size_t size);
+		/** Returns true if the buffer holds a complete header with a valid magic number */
+		bool IsValid() const;
+		/** Returns true if the header contains the ST 268-2 version string. */
+		bool IsHdr() const;
+		/** Get a list (vector) of indices of which IEs are present */
+		std::vector<uint8_t> GetIEIndexList() const;
+
+		/** Gets the value of a string header field
+			@param field			which header field to get
+			@return					string value (empty if the field lies outside the buffer) */
+		std::string GetHeader(HdrDpxFieldsString field) const;
+		/** Gets the value of a U32 header field
+			@param field			which header field to get
+			@return					U32 value */
+		uint32_t GetHeader(HdrDpxFieldsU32 field) const;
+		/** Gets the value of a U16 header field
+			@param field			which header field to get
+			@return					U16 value */
+		uint16_t GetHeader(HdrDpxFieldsU16 field) const;
+		/** Gets the value of a R32 header field
+			@param field			which header field to get
+			@return					R32 value */
+		float GetHeader(HdrDpxFieldsR32 field) const;
+		/** Gets the value of a U8 header field
+			@param field			which header field to get
+			@return					U8 value */
+		uint8_t GetHeader(HdrDpxFieldsU8 field) const;
+		/** Gets the value of the ditto key header field
+			@param field			selects ditto key field
+			@return					ditto key value */
+		HdrDpxDittoKey GetHeader(HdrDpxFieldsDittoKey field) const;
+		/** Gets the value of the datum mapping direction header field
+			@param field			selects datum mapping direction field
+			@return					datum mapping direction value */
+		HdrDpxDatumMappingDirection GetHeader(HdrDpxFieldsDatumMappingDirection field) const;
+		/** Gets the value of the orientation header field
+			@param field			selects orientation field
+			@return					orientation value */
+		HdrDpxOrientation GetHeader(HdrDpxFieldsOrientation field) const;
+		/** Gets the value of the time code header field
+			@param field			selects time code field
+			@return					time code value */
+		SMPTETimeCode GetHeader(HdrDpxFieldsTimeCode field) const;
+		/** Gets the value of the user bits header field
+			@param field			selects user bits field
+			@return					user bits value */
+		SMPTEUserBits GetHeader(HdrDpxFieldsUserBits field) const;
+		/** Gets the value of the interlace header field
+			@param field			selects interlace field
+			@return					interlace value */
+		HdrDpxInterlace GetHeader(HdrDpxFieldsInterlace field) const;
+		/** Gets the value of the video signal header field
+			@param field			selects video signal field
+			@return					video signal field value */
+		HdrDpxVideoSignal GetHeader(HdrDpxFieldsVideoSignal field) const;
+		/** Gets the value of the VIC header field
+			@param field			selects VIC field
+			@return					VIC value */
+		HdrDpxVideoIdentificationCode GetHeader(HdrDpxFieldsVideoIdentificationCode field) const;
+		/** Gets the value of the time code type header field
+			@param field			selects time code type
+			@return					time code type value */
+		HdrDpxSMPTETCType GetHeader(HdrDpxFieldsSMPTETCType field) const;
+		/** Gets the byte order of the header
+			@param field			selects byte order
+			@return					byte order of the header */
+		HdrDpxByteOrder GetHeader(HdrDpxFieldsByteOrder field) const;
+		/** Gets the value of the version header field
+			@param field			selects version header field
+			@return					version field value */
+		HdrDpxVersion GetHeader(HdrDpxFieldsVersion field) const;
+		/** Gets the user-defined data section
+			@param[out] userid		returns the user identification string
+			@param[out] userdata	returns the user data bytes
+			@return					true if user data present and inside the buffer, false if not */
+		bool GetUserData(std::string &userid, std::vector<uint8_t> &userdata) const;
+		/** Gets the standards-based metadata section
+			@param[out] sbm_descriptor	returns the standards-based metadata descriptor
+			@param[out] sbmdata			returns the standards-based metadata bytes
+			@return						true if standards-based metadata present and inside the buffer, false if not */
+		bool GetStandardsBasedMetadata(std::string &sbm_descriptor, std::vector<uint8_t> &sbmdata) const;
 
-		ErrorObject m_err;   ///< Error tracking object
+		/** Get the value of the specified U32 image element header field
+			A byte-reversed eOffsetToData written by earlier versions of this library is corrected as HdrDpxFile does when reading.
+			@param ie_index			image element (0-7)
+			@return					header field value */
+		uint32_t GetHeader(uint8_t ie_index, HdrDpxIEFieldsU32 field) const;
+		/** Get the value of the specified R32 image element header field
+			@param ie_index			image element (0-7)
+			@return					header field value */
+		float GetHeader(uint8_t ie_index, HdrDpxIEFieldsR32 field) const;
+		/** Get the value of the specified string image element header field
+			@param ie_index			image element (0-7)
+			@return					string value */
+		std::string GetHeader(uint8_t ie_index, HdrDpxIEFieldsString field) const;
+		/** Get the value of the data sign header field
+			@param ie_index			image element (0-7)
+			@return					data sign */
+		HdrDpxDataSign GetHeader(uint8_t ie_index, HdrDpxFieldsDataSign field) const;
+		/** Get the value of the descriptor header field
+			@param ie_index			image element (0-7)
+			@return					descriptor */
+		HdrDpxDescriptor GetHeader(uint8_t ie_index, HdrDpxFieldsDescriptor field) const;
+		/** Get the value of the transfer characteristic header field
+			@param ie_index			image element (0-7)
+			@return					transfer characteristic */
+		HdrDpxTransfer GetHeader(uint8_t ie_index, HdrDpxFieldsTransfer field) const;
+		/** Get the value of the colorimetric specification header field
+			@param ie_index			image element (0-7)
+			@return					colorimetric specifcation */
+		HdrDpxColorimetric GetHeader(uint8_t ie_index, HdrDpxFieldsColorimetric field) const;
+		/** Get the value of the bit depth header field
+			@param ie_index			image element (0-7)
+			@return					bit depth */
+		HdrDpxBitDepth GetHeader(uint8_t ie_index, HdrDpxFieldsBitDepth field) const;
+		/** Get the value of the packing header field
+			@param ie_index			image element (0-7)
+			@return					packing */
+		HdrDpxPacking GetHeader(uint8_t ie_index, HdrDpxFieldsPacking field) const;
+		/** Get the value of the encoding header field
+			@param ie_index			image element (0-7)
+			@return					encoding */
+		HdrDpxEncoding GetHeader(uint8_t ie_index, HdrDpxFieldsEncoding field) const;
+		/** Get the value of the color difference siting header field
+			@param ie_index			image element (0-7)
+			@return					color difference siting */
+		HdrDpxColorDifferenceSiting GetHeader(uint8_t ie_index, HdrDpxFieldsColorDifferenceSiting field) const;
+
+	private:
+		uint32_t Read32(size_t offset) const;
+		uint16_t Read16(size_t offset) const;
+		uint8_t Read8(size_t offset) const;
+		float ReadR32(size_t offset) const;
+		std::string ReadString(size_t offset, size_t length) const;
+		size_t IEOffset(uint8_t ie_index) const;
+
+		const uint8_t *m_data;   ///< Caller's buffer
+		size_t m_size;   ///< Number of bytes in the caller's buffer
+		bool m_is_valid;   ///< Buffer holds a complete header with a valid magic number
+		bool m_swap;   ///< Header is in the opposite byte order to the machine
 	};
 
 	/** Copy a string to a char * buffer with null termination, without exceeding a maximum size
@@ -35,6 +35,19 @@
 #include <sstream>
 #include <cstring>
 #include <cmath>
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 #include "hdr_dpx.h"
 
 #define WARN_FOR_ALL_FF_STRINGS  1
@@ -61,6 +74,439 @@
 
 using namespace Dpx;
 
+// Read-only stream buffer whose get area is the application's buffer, so reads copy straight out of it
+class MemoryReadBuf : public std::streambuf
+{
+public:
+	MemoryReadBuf(const uint8_t *data, size_t size)
+	{
+		char *p = const_cast<char *>(reinterpret_cast<const char *>(data));
+		setg(p, p, p + (data ? size : 0));
+	}
+
+protected:
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in) override
+	{
+		off_type pos;
+		if (which & std::ios_base::out)
+			return pos_type(off_type(-1));
+		if (dir == std::ios_base::beg)
+			pos = off;
+		else if (dir == std::ios_base::cur)
+			pos = (gptr() - eback()) + off;
+		else
+			pos = (egptr() - eback()) + off;
+		if (pos < 0 || pos > egptr() - eback())
+			return pos_type(off_type(-1));
+		setg(eback(), eback() + pos, egptr());
+		return pos_type(pos);
+	}
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) override
+	{
+		return seekoff(off_type(pos), std::ios_base::beg, which);
+	}
+};
+
+// Unbuffered stream buffer that passes each read and write to an HdrDpxRandomAccessIO object
+class RandomAccessBuf : public std::streambuf
+{
+public:
+	RandomAccessBuf(HdrDpxRandomAccessIO *io) : m_io(io), m_pos(0), m_ch(0) {}
+
+protected:
+	std::streamsize xsgetn(char *s, std::streamsize n) override
+	{
+		DropGetArea();
+		if (m_io == NULL || n <= 0)
+			return 0;
+		size_t count = m_io->Read(m_pos, s, static_cast<size_t>(n));
+		m_pos += count;
+		return static_cast<std::streamsize>(count);
+	}
+	int_type underflow() override
+	{
+		// Hold one character so it can be peeked at; it is given back to the position if not consumed
+		DropGetArea();
+		if (m_io == NULL || m_io->Read(m_pos, &m_ch, 1) != 1)
+			return traits_type::eof();
+		m_pos++;
+		setg(&m_ch, &m_ch, &m_ch + 1);
+		return traits_type::to_int_type(m_ch);
+	}
+	std::streamsize xsputn(const char *s, std::streamsize n) override
+	{
+		DropGetArea();
+		if (m_io == NULL || n <= 0)
+			return 0;
+		size_t count = m_io->Write(m_pos, s, static_cast<size_t>(n));
+		m_pos += count;
+		return static_cast<std::streamsize>(count);
+	}
+	int_type overflow(int_type c) override
+	{
+		if (traits_type::eq_int_type(c, traits_type::eof()))
+			return traits_type::not_eof(c);
+		char ch = traits_type::to_char_type(c);
+		return (xsputn(&ch, 1) == 1) ? c : traits_type::eof();
+	}
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override
+	{
+		off_type pos;
+		DropGetArea();
+		if (m_io == NULL)
+			return pos_type(off_type(-1));
+		if (dir == std::ios_base::beg)
+			pos = off;
+		else if (dir == std::ios_base::cur)
+			pos = static_cast<off_type>(m_pos) + off;
+		else
+			pos = static_cast<off_type>(m_io->GetSize()) + off;
+		if (pos < 0)
+			return pos_type(off_type(-1));
+		m_pos = static_cast<uint64_t>(pos);
+		return pos_type(pos);
+	}
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override
+	{
+		return seekoff(off_type(pos), std::ios_base::beg, which);
+	}
+
+private:
+	void DropGetArea()
+	{
+		if (gptr() < egptr())
+			m_pos -= egptr() - gptr();
+		setg(NULL, NULL, NULL);
+	}
+	HdrDpxRandomAccessIO *m_io;   // application's source or sink
+	uint64_t m_pos;   // current read/write position
+	char m_ch;   // character held by underflow()
+};
+
+// Sink that grows a memory buffer to fit whatever is written to it
+class VectorIO : public HdrDpxRandomAccessIO
+{
+public:
+	VectorIO(std::vector<uint8_t> &buffer) : m_buffer(buffer) {}
+	size_t Read(uint64_t offset, void *data, size_t size) override
+	{
+		if (offset >= m_buffer.size())
+			return 0;
+		size = std::min<size_t>(size, static_cast<size_t>(m_buffer.size() - offset));
+		memcpy(data, m_buffer.data() + offset, size);
+		return size;
+	}
+	size_t Write(uint64_t offset, const void *data, size_t size) override
+	{
+		if (offset + size > m_buffer.size())
+			m_buffer.resize(static_cast<size_t>(offset + size));
+		memcpy(m_buffer.data() + offset, data, size);
+		return size;
+	}
+	uint64_t GetSize() override
+	{
+		return m_buffer.size();
+	}
+
+private:
+	std::vector<uint8_t> &m_buffer;   // buffer written to
+};
+
+// Source for a forward-only input such as a pipe. Bytes are read from the input as they are requested; bytes that are passed
+// over to reach a later offset are kept so they can still be read afterwards, while of the bytes read in order only the last
+// few are kept (rows are read a word or two past their end).
+#define FORWARD_READ_RECENT_SIZE	4096
+
+class ForwardReadIO : public HdrDpxRandomAccessIO
+{
+public:
+	ForwardReadIO(std::istream &is) : m_is(is), m_head(0), m_size(UINT64_MAX) {}
+	~ForwardReadIO()
+	{
+		// Leave the input at the start of whatever follows this file (e.g., the next frame)
+		uint64_t file_size = HeaderFileSize();
+		while (file_size != UINT64_MAX && m_head < file_size && m_is)
+		{
+			char discard[4096];
+			if (ReadInput(discard, static_cast<size_t>(std::min<uint64_t>(sizeof(discard), file_size - m_head))) == 0)
+				break;
+		}
+	}
+	size_t Read(uint64_t offset, void *data, size_t size) override
+	{
+		uint8_t *out = static_cast<uint8_t *>(data);
+		size_t done = 0;
+		while (done < size)
+		{
+			uint64_t pos = offset + done;
+			size_t count;
+			if (pos < m_head && pos >= m_head - m_recent.size())
+			{
+				count = static_cast<size_t>(std::min<uint64_t>(size - done, m_head - pos));
+				memcpy(out + done, m_recent.data() + (m_recent.size() - (m_head - pos)), count);
+			}
+			else if (pos < m_head)
+			{
+				// Already read from the input, so it is only available if it was kept
+				std::map<uint64_t, std::vector<uint8_t>>::const_iterator it = m_kept.upper_bound(pos);
+				if (it == m_kept.begin())
+					break;
+				--it;
+				if (pos >= it->first + it->second.size())
+					break;
+				count = static_cast<size_t>(std::min<uint64_t>(size - done, it->first + it->second.size() - pos));
+				memcpy(out + done, it->second.data() + (pos - it->first), count);
+			}
+			else
+			{
+				if (pos > m_head && !Keep(pos))
+					break;
+				count = ReadInput(reinterpret_cast<char *>(out + done), size - done);
+				if (count == 0)
+					break;
+			}
+			done += count;
+		}
+		return done;
+	}
+	uint64_t GetSize() override
+	{
+		if (m_size == UINT64_MAX)
+		{
+			// Without a usable file size in the header, the size is only known once the whole input has been read
+			m_size = HeaderFileSize();
+			if (m_size == UINT64_MAX || m_size < m_head)
+			{
+				Keep(UINT64_MAX);
+				m_size = m_head;
+			}
+		}
+		return m_size;
+	}
+
+private:
+	size_t ReadInput(char *data, size_t size)
+	{
+		// Never read past the end of this file, which may be followed by another one
+		uint64_t file_size = HeaderFileSize();
+		if (file_size != UINT64_MAX)
+			size = static_cast<size_t>(std::min<uint64_t>(size, file_size > m_head ? file_size - m_head : 0));
+		if (size == 0)
+			return 0;
+		m_is.read(data, size);
+		size_t count = static_cast<size_t>(m_is.gcount());
+		// Keep the start of the generic file header for HeaderFileSize()
+		for (size_t i = 0; m_head + i < sizeof(m_prefix) && i < count; ++i)
+			m_prefix[m_head + i] = data[i];
+		if (count >= FORWARD_READ_RECENT_SIZE)
+			m_recent.assign(data + count - FORWARD_READ_RECENT_SIZE, data + count);
+		else
+		{
+			m_recent.insert(m_recent.end(), data, data + count);
+			if (m_recent.size() > 2 * FORWARD_READ_RECENT_SIZE)
+				m_recent.erase(m_recent.begin(), m_recent.end() - FORWARD_READ_RECENT_SIZE);
+		}
+		m_head += count;
+		return count;
+	}
+	bool Keep(uint64_t end)
+	{
+		// Extend the last kept block if it ends where the new bytes start
+		std::vector<uint8_t> *block;
+		if (!m_kept.empty() && m_kept.rbegin()->first + m_kept.rbegin()->second.size() == m_head)
+			block = &m_kept.rbegin()->second;
+		else
+			block = &m_kept[m_head];
+		while (m_head < end)
+		{
+			size_t old_size = block->size();
+			block->resize(old_size + static_cast<size_t>(std::min<uint64_t>(65536, end - m_head)));
+			size_t count = ReadInput(reinterpret_cast<char *>(block->data() + old_size), block->size() - old_size);
+			block->resize(old_size + count);
+			if (count == 0)
+				return false;
+		}
+		return true;
+	}
+	uint64_t HeaderFileSize() const
+	{
+		uint32_t magic, file_size;
+		if (m_head < sizeof(m_prefix))
+			return UINT64_MAX;
+		memcpy(&magic, m_prefix + offsetof(HDRDPX_GENERICFILEHEADER, Magic), 4);
+		memcpy(&file_size, m_prefix + offsetof(HDRDPX_GENERICFILEHEADER, FileSize), 4);
+		if (magic == 0x58504453)
+			ByteSwap32(&file_size);
+		else if (magic != 0x53445058)
+			return UINT64_MAX;
+		if (file_size == UNDEFINED_U32 || file_size < sizeof(HDRDPXFILEFORMAT))
+			return UINT64_MAX;
+		return file_size;
+	}
+
+	std::istream &m_is;   // input being read
+	uint64_t m_head;   // number of bytes read from the input so far
+	uint64_t m_size;   // size of the file once known (UINT64_MAX before)
+	std::map<uint64_t, std::vector<uint8_t>> m_kept;   // blocks passed over before they were requested, by starting offset
+	std::vector<uint8_t> m_recent;   // last bytes read from the input (ending at m_head)
+	char m_prefix[offsetof(HDRDPX_GENERICFILEHEADER, FileSize) + 4];   // first bytes of the file
+};
+
+// Sink for a forward-only output such as a pipe. Bytes written at the current end of the output are passed straight through;
+// bytes written further on are held until everything before them has been written. Bytes that have already been passed to
+// the output cannot be changed, so such writes fail.
+class ForwardWriteIO : public HdrDpxRandomAccessIO
+{
+public:
+	ForwardWriteIO(std::ostream &os) : m_os(os), m_head(0) {}
+	~ForwardWriteIO()
+	{
+		// Anything still held is written out, with any gaps before it filled with zeros
+		while (!m_pending.empty() && m_os)
+		{
+			std::vector<uint8_t> zeros(static_cast<size_t>(std::min<uint64_t>(65536, m_pending.begin()->first - m_head)));
+			if (zeros.empty())
+				Flush();
+			else
+				Emit(zeros.data(), zeros.size());
+		}
+		m_os.flush();
+	}
+	size_t Write(uint64_t offset, const void *data, size_t size) override
+	{
+		if (offset < m_head)
+			return 0;
+		if (offset > m_head)
+		{
+			std::vector<uint8_t> &block = m_pending[offset];
+			block.assign(static_cast<const uint8_t *>(data), static_cast<const uint8_t *>(data) + size);
+			return size;
+		}
+		if (!Emit(static_cast<const uint8_t *>(data), size))
+			return 0;
+		Flush();
+		return size;
+	}
+	uint64_t GetSize() override
+	{
+		uint64_t size = m_head;
+		if (!m_pending.empty())
+			size = std::max<uint64_t>(size, m_pending.rbegin()->first + m_pending.rbegin()->second.size());
+		return size;
+	}
+
+private:
+	bool Emit(const uint8_t *data, size_t size)
+	{
+		m_os.write(reinterpret_cast<const char *>(data), size);
+		if (!m_os)
+			return false;
+		m_head += size;
+		return true;
+	}
+	void Flush()
+	{
+		// Write out held blocks that now start at (or overlap) the end of the output
+		while (!m_pending.empty() && m_pending.begin()->first <= m_head && m_os)
+		{
+			std::map<uint64_t, std::vector<uint8_t>>::iterator it = m_pending.begin();
+			uint64_t end = it->first + it->second.size();
+			if (end > m_head)
+				Emit(it->second.data() + (m_head - it->first), static_cast<size_t>(end - m_head));
+			m_pending.erase(it);
+		}
+	}
+
+	std::ostream &m_os;   // output being written
+	uint64_t m_head;   // number of bytes written to the output so far
+	std::map<uint64_t, std::vector<uint8_t>> m_pending;   // blocks written ahead of the output, by starting offset
+};
+
+// Sink that writes into a file mapped into memory. The file is created at its final size (with space allocated for it
+// where the platform allows), so this is only used when the whole layout is known before anything is written.
+class MappedFileIO : public HdrDpxRandomAccessIO
+{
+public:
+	MappedFileIO(const std::string &filename, uint64_t size) : m_data(NULL), m_size(size)
+	{
+#ifdef _WIN32
+		m_mapping = NULL;
+		m_file = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (m_file == INVALID_HANDLE_VALUE)
+			return;
+		// Creating a mapping larger than the file extends the file
+		m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), NULL);
+		if (m_mapping != NULL)
+			m_data = static_cast<uint8_t *>(MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(size)));
+#else
+		m_fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+		if (m_fd < 0)
+			return;
+#ifdef __linux__
+		// Allocating the space up front means running out of disk space is reported here rather than as a fault while writing
+		int err = posix_fallocate(m_fd, 0, static_cast<off_t>(size));
+		if (err != 0 && err != EINVAL && err != EOPNOTSUPP)
+			return;
+#endif
+		if (ftruncate(m_fd, static_cast<off_t>(size)) != 0)
+			return;
+		void *data = mmap(NULL, static_cast<size_t>(size), PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+		if (data != MAP_FAILED)
+			m_data = static_cast<uint8_t *>(data);
+#endif
+	}
+	~MappedFileIO()
+	{
+#ifdef _WIN32
+		if (m_data != NULL)
+			UnmapViewOfFile(m_data);
+		if (m_mapping != NULL)
+			CloseHandle(m_mapping);
+		if (m_file != INVALID_HANDLE_VALUE)
+			CloseHandle(m_file);
+#else
+		if (m_data != NULL)
+			munmap(m_data, static_cast<size_t>(m_size));
+		if (m_fd >= 0)
+			close(m_fd);
+#endif
+	}
+	size_t Read(uint64_t offset, void *data, size_t size) override
+	{
+		if (m_data == NULL || offset >= m_size)
+			return 0;
+		size = std::min<size_t>(size, static_cast<size_t>(m_size - offset));
+		memcpy(data, m_data + offset, size);
+		return size;
+	}
+	size_t Write(uint64_t offset, const void *data, size_t size) override
+	{
+		if (m_data == NULL || offset >= m_size)
+			return 0;
+		size = std::min<size_t>(size, static_cast<size_t>(m_size - offset));
+		memcpy(m_data + offset, data, size);
+		return size;
+	}
+	uint64_t GetSize() override
+	{
+		return m_size;
+	}
+	uint8_t *GetData() const
+	{
+		return m_data;
+	}
+
+private:
+#ifdef _WIN32
+	HANDLE m_file;   // file being written
+	HANDLE m_mapping;   // mapping object for the file
+#else
+	int m_fd;   // file being written
+#endif
+	uint8_t *m_data;   // start of the mapped file (NULL if it could not be mapped)
+	uint64_t m_size;   // size of the file
+};
+
 
 bool Dpx::CopyStringN(char *dest, std::string src, unsigned int max_length)
 {
@@ -119,36 +565,243 @@ HdrDpxFile::~HdrDpxFile()
 		m_file_stream.close();
 }
 
+HdrDpxFile::HdrDpxFile(HdrDpxFile &&other)
+{
+	*this = std::move(other);
+}
+
+HdrDpxFile &HdrDpxFile::operator=(HdrDpxFile &&other)
+{
+	if (this == &other)
+		return *this;
+	DiscardPendingSections();   // replaced by the sections of other
+	Close();
+
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+		m_IE[ie_idx] = std::move(other.m_IE[ie_idx]);
+	m_warn_messages = std::move(other.m_warn_messages);
+	m_file_name = std::move(other.m_file_name);
+	m_file_is_hdr_version = other.m_file_is_hdr_version;
+	m_machine_is_msbf = other.m_machine_is_msbf;
+	m_sbm_present = other.m_sbm_present;
+	m_open_for_write = other.m_open_for_write;
+	m_open_for_read = other.m_open_for_read;
+	m_is_header_locked = other.m_is_header_locked;
+	m_file_stream = std::move(other.m_file_stream);
+	m_owned_io = std::move(other.m_owned_io);
+	m_stream_buf = std::move(other.m_stream_buf);
+	m_buf_stream = std::move(other.m_buf_stream);
+	m_stream = m_buf_stream ? m_buf_stream.get() : &m_file_stream;
+	m_forward_only = other.m_forward_only;
+	m_mapped_writing = other.m_mapped_writing;
+	m_data_alignment = other.m_data_alignment;
+	m_align_rows = other.m_align_rows;
+	m_preallocate = other.m_preallocate;
+	m_header_update = other.m_header_update;
+	m_userdata_changed = other.m_userdata_changed;
+	m_sbmdata_changed = other.m_sbmdata_changed;
+	m_update_user_size = other.m_update_user_size;
+	m_update_sbm_size = other.m_update_sbm_size;
+	m_ud_dump = other.m_ud_dump;
+	m_ud_dump_format = other.m_ud_dump_format;
+	m_sbm_dump = other.m_sbm_dump;
+	m_sbm_dump_format = other.m_sbm_dump_format;
+	m_write_rle_row_index = other.m_write_rle_row_index;
+	m_has_rle_row_index = other.m_has_rle_row_index;
+	m_buffer_rle = other.m_buffer_rle;
+	m_optimal_rle = other.m_optimal_rle;
+	m_byteorder = other.m_byteorder;
+	m_dpx_header = other.m_dpx_header;
+	m_dpx_sbmdata = std::move(other.m_dpx_sbmdata);
+	m_dpx_userdata = std::move(other.m_dpx_userdata);
+	m_userdata_pending = other.m_userdata_pending;
+	m_sbmdata_pending = other.m_sbmdata_pending;
+	m_filemap = std::move(other.m_filemap);
+	m_has_read_header = other.m_has_read_header;
+	m_header_is_ditto = other.m_header_is_ditto;
+	m_has_ditto_template = other.m_has_ditto_template;
+	m_ditto_ie_mask = other.m_ditto_ie_mask;
+	m_ditto_template = other.m_ditto_template;
+	m_ditto_requested = other.m_ditto_requested;
+	m_ditto_previous = other.m_ditto_previous;
+	m_ditto_sbm_length = other.m_ditto_sbm_length;
+	m_ditto_filemap = std::move(other.m_ditto_filemap);
+	m_has_ditto_validation = other.m_has_ditto_validation;
+	m_ditto_validation = std::move(other.m_ditto_validation);
+	m_err = std::move(other.m_err);
+
+	// The image elements point into the object that owns them
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+		m_IE[ie_idx].Rebind(m_stream, &m_dpx_header, &m_filemap);
+
+	// Leave the other object closed and blank
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+		other.m_IE[ie_idx].m_isinitialized = false;
+	other.m_open_for_read = false;
+	other.m_open_for_write = false;
+	other.m_is_header_locked = false;
+	other.m_header_update = false;
+	other.m_stream = &other.m_file_stream;
+	other.ClearHeader();
+	return *this;
+}
+
+void HdrDpxFile::Reopen(std::string filename)
+{
+	DiscardPendingSections();   // replaced by the sections of the next file
+	Close();
+	OpenForReading(filename, true);
+}
+
 void HdrDpxFile::OpenForReading(std::string filename)
 {
-	ErrorObject err;
-	
+	OpenForReading(filename, false);
+}
+
+void HdrDpxFile::ReopenForWriting(std::string filename)
+{
+	Close();
+	OpenForWriting(filename, true);
+}
+
+void HdrDpxFile::OpenForHeaderUpdate(std::string filename)
+{
+	m_file_stream.open(filename, std::ios::binary | std::ios::in | std::ios::out);
+	m_stream = &m_file_stream;
+	m_file_name = filename;
+	OpenStreamForReading(false);
+	if (!m_open_for_read)
+		return;
+
+	// Both sections are held in memory, so whatever is not changed is rewritten as read
+	LoadUserData();
+	LoadSbmData();
+	m_update_user_size = (m_dpx_header.FileHeader.UserSize == UNDEFINED_U32) ? 0 : m_dpx_header.FileHeader.UserSize;
+	m_update_sbm_size = (m_file_is_hdr_version && m_dpx_header.FileHeader.StandardsBasedMetadataOffset != UNDEFINED_U32) ? 132 + m_dpx_sbmdata.SbmData.size() : 0;
+	m_userdata_changed = false;
+	m_sbmdata_changed = false;
+	m_header_update = true;
+	m_is_header_locked = false;
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+	{
+		if (m_IE[ie_idx].m_isinitialized)
+		{
+			m_IE[ie_idx].UnlockHeader();
+			m_IE[ie_idx].m_is_layout_locked = true;
+		}
+	}
+}
+
+void HdrDpxFile::PatchDittoHeader(const HDRDPXFILEFORMAT &raw_header, bool byte_swap)
+{
+	// Everything else matches the previous frame, which has already been byte swapped and checked
+	m_dpx_header.FileHeader.ImageOffset = raw_header.FileHeader.ImageOffset;
+	m_dpx_header.FileHeader.FileSize = raw_header.FileHeader.FileSize;
+	m_dpx_header.FileHeader.DittoKey = raw_header.FileHeader.DittoKey;
+	m_dpx_header.FileHeader.UserSize = raw_header.FileHeader.UserSize;
+	m_dpx_header.FileHeader.StandardsBasedMetadataOffset = raw_header.FileHeader.StandardsBasedMetadataOffset;
+	m_dpx_header.FilmHeader.FramePosition = raw_header.FilmHeader.FramePosition;
+	m_dpx_header.TvHeader.TimeCode = raw_header.TvHeader.TimeCode;
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+		m_dpx_header.ImageHeader.ImageElement[ie_idx].DataOffset = raw_header.ImageHeader.ImageElement[ie_idx].DataOffset;
+	if (byte_swap)
+	{
+		ByteSwap32(&(m_dpx_header.FileHeader.ImageOffset));
+		ByteSwap32(&(m_dpx_header.FileHeader.FileSize));
+		ByteSwap32(&(m_dpx_header.FileHeader.DittoKey));
+		ByteSwap32(&(m_dpx_header.FileHeader.UserSize));
+		ByteSwap32(&(m_dpx_header.FileHeader.StandardsBasedMetadataOffset));
+		ByteSwap32(&(m_dpx_header.FilmHeader.FramePosition));
+		ByteSwap32(&(m_dpx_header.TvHeader.TimeCode));
+		for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+			ByteSwap32(&(m_dpx_header.ImageHeader.ImageElement[ie_idx].DataOffset));
+		CorrectLegacyDataOffsets();
+	}
+}
+
+void HdrDpxFile::OpenForReading(const uint8_t *data, size_t size)
+{
+	UseStreamBuffer(new MemoryReadBuf(data, size), "[memory buffer]");
+	OpenStreamForReading(false);
+}
+
+void HdrDpxFile::OpenForReading(HdrDpxRandomAccessIO *io)
+{
+	UseStreamBuffer(new RandomAccessBuf(io), "[application I/O]");
+	OpenStreamForReading(false);
+}
+
+void HdrDpxFile::OpenForReading(std::istream &is)
+{
+	m_owned_io.reset(new ForwardReadIO(is));
+	UseStreamBuffer(new RandomAccessBuf(m_owned_io.get()), "[input stream]");
+	OpenStreamForReading(false);
+}
+
+void HdrDpxFile::UseStreamBuffer(std::streambuf *buf, std::string name)
+{
+	m_stream_buf.reset(buf);
+	m_buf_stream.reset(new std::iostream(buf));
+	m_stream = m_buf_stream.get();
+	m_file_name = name;
+}
+
+void HdrDpxFile::OpenForReading(std::string filename, bool reuse_layout)
+{
 	m_file_stream.open(filename, std::ios::binary | std::ios::in);
+	m_stream = &m_file_stream;
+	m_file_name = filename;
+	OpenStreamForReading(reuse_layout);
+}
+
+void HdrDpxFile::OpenStreamForReading(bool reuse_layout)
+{
+	ErrorObject err;
+	HDRDPXFILEFORMAT raw_header;
+	bool swapped;
 
 	m_err.Clear();
 	m_warn_messages.clear();
-	m_file_name = filename;
+	m_has_rle_row_index = false;
 
-	if (!m_file_stream)
+	if (!*m_stream)
 	{
-		LOG_ERROR(eFileOpenError, eFatal, "Unable to open file " + filename + "\n");
+		LOG_ERROR(eFileOpenError, eFatal, "Unable to open file " + m_file_name + "\n");
 		return;
 	}
-	m_file_stream.read((char *)&m_dpx_header, sizeof(HDRDPXFILEFORMAT));
-	bool swapped = ByteSwapToMachine();
-	if (m_file_stream.eof() || m_dpx_header.FileHeader.Magic != 0x53445058)
+	m_stream->read((char *)&raw_header, sizeof(HDRDPXFILEFORMAT));
+
+	// A ditto key of 0 reads the same in either byte order. If the file also has the byte order of the previous frame,
+	// only the fields that change from frame to frame are taken from the new header.
+	m_header_is_ditto = reuse_layout && m_has_read_header && !m_stream->eof() && raw_header.FileHeader.DittoKey == eDittoKeySame &&
+		raw_header.FileHeader.Magic == (IsByteSwapNeeded() ? 0x58504453 : 0x53445058);
+	if (m_header_is_ditto)
 	{
-		LOG_ERROR(eFileOpenError, eFatal, "Header is not valid\n");
-		return;
+		swapped = IsByteSwapNeeded();
+		PatchDittoHeader(raw_header, swapped);
 	}
-
-	if ((m_machine_is_msbf && swapped) || (!m_machine_is_msbf && !swapped))
-		m_byteorder = eLSBF;
 	else
-		m_byteorder = eMSBF;
-	if (m_file_stream.bad())
 	{
-		LOG_ERROR(eFileReadError, eFatal, "Error attempting to read file " + filename + "\n");
+		m_has_read_header = false;
+		m_has_ditto_validation = false;
+		m_dpx_header = raw_header;
+		// Check the magic number before swapping, so the fields of a file that is not DPX are left alone
+		if (m_stream->eof() || (m_dpx_header.FileHeader.Magic != 0x53445058 && m_dpx_header.FileHeader.Magic != 0x58504453))
+		{
+			LOG_ERROR(eFileOpenError, eFatal, "Header is not valid\n");
+			return;
+		}
+		swapped = ByteSwapToMachine();
+
+		if ((m_machine_is_msbf && swapped) || (!m_machine_is_msbf && !swapped))
+			m_byteorder = eLSBF;
+		else
+			m_byteorder = eMSBF;
+		m_file_is_hdr_version = (static_cast<bool>(!strcmp(m_dpx_header.FileHeader.Version, "V2.0HDR")));
+	}
+	if (m_stream->bad())
+	{
+		LOG_ERROR(eFileReadError, eFatal, "Error attempting to read file " + m_file_name + "\n");
 		m_file_stream.close();
 		return;
 	}
@@ -158,47 +811,113 @@ void HdrDpxFile::OpenForReading(std::string filename)
 	{
 		if (m_dpx_header.ImageHeader.ImageElement[ie_idx].DataOffset != UNDEFINED_U32)
 		{
-			m_IE[ie_idx].Initialize(ie_idx, &m_file_stream, &m_dpx_header, &m_filemap);
-			m_IE[ie_idx].OpenForReading(swapped);
+			if (!reuse_layout || !m_IE[ie_idx].ReopenForReading(swapped))
+			{
+				m_IE[ie_idx].Initialize(ie_idx, m_stream, &m_dpx_header, &m_filemap);
+				m_IE[ie_idx].OpenForReading(swapped);
+			}
+			else
+				m_IE[ie_idx].Rebind(m_stream, &m_dpx_header, &m_filemap);
 		}
 		else
 			m_IE[ie_idx].m_isinitialized = false;
 	}
-	m_file_is_hdr_version = (static_cast<bool>(!strcmp(m_dpx_header.FileHeader.Version, "V2.0HDR")));
-
-	ReadUserData();
-	if (m_file_is_hdr_version)
-		ReadSbmData();
 
+	// Drop user data and metadata left from a previous file (keeping the storage). They are read when first accessed,
+	// except that the user data of a file with RLE image elements may hold the row index needed to read them.
+	m_dpx_userdata.UserData.clear();
+	m_dpx_sbmdata.SbmData.clear();
+	m_userdata_pending = (m_dpx_header.FileHeader.UserSize != 0 && m_dpx_header.FileHeader.UserSize != UNDEFINED_U32);
+	m_sbmdata_pending = (m_file_is_hdr_version && m_dpx_header.FileHeader.StandardsBasedMetadataOffset != UNDEFINED_U32);
+	m_has_read_header = true;
 	m_open_for_write = false;
 	m_open_for_read = true;
 	m_is_header_locked = true;
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+	{
+		if (m_IE[ie_idx].m_isinitialized && m_dpx_header.ImageHeader.ImageElement[ie_idx].Encoding == 1)
+		{
+			LoadUserData();
+			if (CopyToStringN(m_dpx_userdata.UserIdentification, 32) == RLE_ROW_INDEX_USERID)
+				m_has_rle_row_index = DecodeRLERowIndex();
+			break;
+		}
+	}
 }
 
 
-void HdrDpxFile::ReadUserData()
+void HdrDpxFile::Probe(std::string filename)
+{
+	std::ifstream is;
+
+	DiscardPendingSections();   // a probe does not read the sections
+	Close();
+	m_err.Clear();
+	m_warn_messages.clear();
+	m_file_name = filename;
+	m_has_rle_row_index = false;
+	m_has_read_header = false;
+	m_has_ditto_validation = false;
+	m_dpx_userdata.UserData.clear();
+	m_dpx_sbmdata.SbmData.clear();
+	m_filemap.Reset();
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+		m_IE[ie_idx].m_isinitialized = false;
+
+	// Without a stream buffer the header is read straight into place with one system call
+	is.rdbuf()->pubsetbuf(NULL, 0);
+	is.open(filename, std::ios::binary | std::ios::in);
+	if (!is)
+	{
+		LOG_ERROR(eFileOpenError, eFatal, "Unable to open file " + filename + "\n");
+		return;
+	}
+	is.read((char *)&m_dpx_header, sizeof(HDRDPXFILEFORMAT));
+	if (is.gcount() != sizeof(HDRDPXFILEFORMAT) || (m_dpx_header.FileHeader.Magic != 0x53445058 && m_dpx_header.FileHeader.Magic != 0x58504453))
+	{
+		LOG_ERROR(eFileOpenError, eFatal, "Header is not valid\n");
+		return;
+	}
+	bool swapped = ByteSwapToMachine();
+	if ((m_machine_is_msbf && swapped) || (!m_machine_is_msbf && !swapped))
+		m_byteorder = eLSBF;
+	else
+		m_byteorder = eMSBF;
+	m_file_is_hdr_version = (static_cast<bool>(!strcmp(m_dpx_header.FileHeader.Version, "V2.0HDR")));
+
+	// Bind the image elements that are present so their header fields can be queried
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+		if (m_dpx_header.ImageHeader.ImageElement[ie_idx].DataOffset != UNDEFINED_U32)
+			m_IE[ie_idx].Initialize(ie_idx, m_stream, &m_dpx_header, &m_filemap);
+}
+
+void HdrDpxFile::ReadUserData(std::istream &is) const
 {
 	if (m_dpx_header.FileHeader.UserSize == 0 || m_dpx_header.FileHeader.UserSize == UNDEFINED_U32)
 		return;   // Nothing to do, no user data
+	if (m_dpx_header.FileHeader.UserSize < 32)
+	{
+		LOG_ERROR(eFileReadError, eWarning, "User data size is smaller than the user identification field\n");
+		return;
+	}
 
-	for (uint32_t i = 0; i < 32; ++i)
-		m_file_stream.get(m_dpx_userdata.UserIdentification[i]);
+	is.seekg(sizeof(HDRDPXFILEFORMAT), std::ios::beg);
+	is.read(m_dpx_userdata.UserIdentification, 32);
 
-	std::streampos cur_ptr = m_file_stream.tellg();
-	m_file_stream.seekg(0, std::ios::end);
+	std::streampos cur_ptr = is.tellg();
+	is.seekg(0, std::ios::end);
 	if (static_cast<std::streamoff>(cur_ptr) + static_cast<std::streamoff>(m_dpx_header.FileHeader.UserSize) > 
-			m_file_stream.tellg())
+			is.tellg())
 	{
 		LOG_ERROR(eFileReadError, eWarning, "User data size is larger than file size\n");
 		return;
 	}
-	m_file_stream.seekg(cur_ptr);
+	is.seekg(cur_ptr);
 
-	m_dpx_userdata.UserData.clear();
-	for (uint32_t i = 0; i < m_dpx_header.FileHeader.UserSize - 32 && !m_file_stream.bad(); ++i)
-		m_dpx_userdata.UserData.push_back(static_cast<unsigned char>(m_file_stream.get()));
+	m_dpx_userdata.UserData.resize(m_dpx_header.FileHeader.UserSize - 32);
+	is.read(reinterpret_cast<char *>(m_dpx_userdata.UserData.data()), m_dpx_userdata.UserData.size());
 
-	if (m_file_stream.bad() || m_file_stream.eof())
+	if (is.bad() || is.eof())
 	{
 		LOG_ERROR(eFileReadError, eWarning, "Error attempting to read user data\n");
 		return;
@@ -206,83 +925,316 @@ void HdrDpxFile::ReadUserData()
 }
 
 
-void HdrDpxFile::ReadSbmData()
+void HdrDpxFile::WriteUserData()
 {
-	if (m_dpx_header.FileHeader.StandardsBasedMetadataOffset == UNDEFINED_U32)
-		return;		// Nothing to do, no standards-based metadata
+	if (m_dpx_header.FileHeader.UserSize == 0 || m_dpx_header.FileHeader.UserSize == UNDEFINED_U32)
+		return;   // Nothing to do, no user data
 
-	m_file_stream.seekg(m_dpx_header.FileHeader.StandardsBasedMetadataOffset, m_file_stream.beg);
+	m_stream->seekp(sizeof(HDRDPXFILEFORMAT), std::ios::beg);
+	m_stream->write(m_dpx_userdata.UserIdentification, 32);
+	m_stream->write((char *)m_dpx_userdata.UserData.data(), m_dpx_userdata.UserData.size());
+	if (m_stream->bad())
+		LOG_ERROR(eFileWriteError, eWarning, "Error attempting to write user data\n");
+}
 
-	for (uint32_t i = 0; i < 128; ++i)
-		m_file_stream.get(m_dpx_sbmdata.SbmFormatDescriptor[i]);
 
-	unsigned char sizebytes[4];
-	for (uint32_t i = 0; i < 4; ++i)
-		sizebytes[i] = static_cast<unsigned char>(m_file_stream.get());
+static void PutIndexU32(std::vector<uint8_t> &buf, size_t &pos, uint32_t value, bool byte_swap)
+{
+	if (byte_swap)
+		ByteSwap32(&value);
+	memcpy(&buf[pos], &value, 4);
+	pos += 4;
+}
 
-	if (m_byteorder == eLSBF)
-		m_dpx_sbmdata.SbmLength = (sizebytes[3] << 24) | (sizebytes[2] << 16) | (sizebytes[1] << 8) | sizebytes[0];
-	else
-		m_dpx_sbmdata.SbmLength = (sizebytes[0] << 24) | (sizebytes[1] << 16) | (sizebytes[2] << 8) | sizebytes[3];
+static uint32_t GetIndexU32(const std::vector<uint8_t> &buf, size_t &pos, bool byte_swap)
+{
+	uint32_t value;
+	memcpy(&value, &buf[pos], 4);
+	pos += 4;
+	if (byte_swap)
+		ByteSwap32(&value);
+	return value;
+}
 
-	if (m_file_stream.bad() || m_file_stream.eof())
+
+void HdrDpxFile::PrepareRLERowIndex()
+{
+	uint32_t index_size = 8;
+	bool user_data_present = (m_dpx_header.FileHeader.UserSize != 0 && m_dpx_header.FileHeader.UserSize != UNDEFINED_U32);
+
+	if (user_data_present && CopyToStringN(m_dpx_userdata.UserIdentification, 32) == RLE_ROW_INDEX_USERID)
 	{
-		LOG_ERROR(eFileReadError, eWarning, "Error attempting to read standards-based data\n");
-		return;
+		// A row index copied from another file does not describe this file, so never write it out as-is
+		m_dpx_userdata.UserData.clear();
+		m_dpx_header.FileHeader.UserSize = 0;
+		user_data_present = false;
 	}
+	if (!m_write_rle_row_index)
+		return;
 
-	for (uint32_t i = 0; i < m_dpx_sbmdata.SbmLength; ++i)
-		m_dpx_sbmdata.SbmData.push_back(static_cast<unsigned char>(m_file_stream.get()));
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+	{
+		if (m_IE[ie_idx].m_isinitialized && m_IE[ie_idx].GetHeader(eEncoding) == eEncodingRLE)
+		{
+			m_IE[ie_idx].ComputeLayout();
+			index_size += 12 + 4 * m_IE[ie_idx].GetHeight();
+		}
+	}
+	if (index_size == 8)
+		return;   // No RLE image elements, nothing to index
 
-	if (m_file_stream.bad() || m_file_stream.eof())
+	if (user_data_present)
 	{
-		LOG_ERROR(eFileReadError, eWarning, "Error attempting to read standards-based data\n");
+		LOG_ERROR(eBadParameter, eWarning, "User data section is already in use, RLE row index not written");
 		return;
 	}
+	if (index_size + 32 > 1000000)
+	{
+		LOG_ERROR(eBadParameter, eWarning, "RLE row index exceeds the maximum user data length, RLE row index not written");
+		return;
+	}
+	CopyStringN(m_dpx_userdata.UserIdentification, RLE_ROW_INDEX_USERID, 32);
+	m_dpx_userdata.UserData.assign(index_size, 0);
+	m_dpx_header.FileHeader.UserSize = index_size + 32;
 }
 
 
-HdrDpxImageElement *HdrDpxFile::GetImageElement(uint8_t ie_idx)
+void HdrDpxFile::EncodeRLERowIndex()
 {
-	if (ie_idx < 0 || ie_idx > 7)
+	std::vector<uint8_t> &index = m_dpx_userdata.UserData;
+	const bool byte_swap = IsByteSwapNeeded();
+	size_t pos = 0;
+	uint32_t num_ie = 0;
+
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
 	{
-		LOG_ERROR(eBadParameter, eFatal, "Image element number out of bounds\n");
-		return NULL;
+		if (m_IE[ie_idx].m_isinitialized && m_IE[ie_idx].GetHeader(eEncoding) == eEncodingRLE)
+		{
+			for (uint32_t row_offset : m_IE[ie_idx].m_rle_row_offsets)
+			{
+				if (row_offset == UNDEFINED_U32)
+				{
+					LOG_ERROR(eFileWriteError, eWarning, "Not all rows of image element " + std::to_string(ie_idx + 1) + " were written, RLE row index left empty");
+					PutIndexU32(index, pos, RLE_ROW_INDEX_VERSION, byte_swap);
+					PutIndexU32(index, pos, 0, byte_swap);
+					return;
+				}
+			}
+			num_ie++;
+		}
 	}
-	if (!m_IE[ie_idx].m_isinitialized)
+
+	PutIndexU32(index, pos, RLE_ROW_INDEX_VERSION, byte_swap);
+	PutIndexU32(index, pos, num_ie, byte_swap);
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
 	{
-		m_IE[ie_idx].Initialize(ie_idx, &m_file_stream, &m_dpx_header, &m_filemap);
+		if (m_IE[ie_idx].m_isinitialized && m_IE[ie_idx].GetHeader(eEncoding) == eEncodingRLE)
+		{
+			PutIndexU32(index, pos, ie_idx, byte_swap);
+			PutIndexU32(index, pos, m_IE[ie_idx].GetHeader(eOffsetToData), byte_swap);
+			PutIndexU32(index, pos, static_cast<uint32_t>(m_IE[ie_idx].m_rle_row_offsets.size()), byte_swap);
+			for (uint32_t row_offset : m_IE[ie_idx].m_rle_row_offsets)
+				PutIndexU32(index, pos, row_offset, byte_swap);
+		}
 	}
-	return &(m_IE[ie_idx]);
 }
 
 
-void HdrDpxFile::ByteSwapHeader(void)
+bool HdrDpxFile::DecodeRLERowIndex()
 {
-	ByteSwap32(&(m_dpx_header.FileHeader.Magic));
-	ByteSwap32(&(m_dpx_header.FileHeader.ImageOffset));
-	ByteSwap32(&(m_dpx_header.FileHeader.FileSize));
-	ByteSwap32(&(m_dpx_header.FileHeader.DittoKey));
-	ByteSwap32(&(m_dpx_header.FileHeader.GenericSize));
-	ByteSwap32(&(m_dpx_header.FileHeader.IndustrySize));
-	ByteSwap32(&(m_dpx_header.FileHeader.UserSize));
-	ByteSwap32(&(m_dpx_header.FileHeader.EncryptKey));
-	ByteSwap32(&(m_dpx_header.FileHeader.StandardsBasedMetadataOffset));
-
-	ByteSwap16(&(m_dpx_header.ImageHeader.Orientation));
-	ByteSwap16(&(m_dpx_header.ImageHeader.NumberElements));
-	ByteSwap32(&(m_dpx_header.ImageHeader.PixelsPerLine));
-	ByteSwap32(&(m_dpx_header.ImageHeader.LinesPerElement));
-	ByteSwap32(&(m_dpx_header.ImageHeader.ChromaSubsampling));
+	const std::vector<uint8_t> &index = m_dpx_userdata.UserData;
+	const bool byte_swap = IsByteSwapNeeded();
+	std::vector<std::vector<uint32_t>> row_offsets(NUM_IMAGE_ELEMENTS);
+	size_t pos = 0;
+	uint32_t num_ie;
 
-	for (int ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+	if (index.size() < 8)
+	{
+		LOG_ERROR(eFileReadError, eWarning, "RLE row index is truncated, ignoring it\n");
+		return false;
+	}
+	if (GetIndexU32(index, pos, byte_swap) != RLE_ROW_INDEX_VERSION)
+	{
+		LOG_ERROR(eFileReadError, eInformational, "Unsupported RLE row index version, ignoring it\n");
+		return false;
+	}
+
+	m_stream->seekg(0, std::ios::end);
+	const uint32_t file_size = static_cast<uint32_t>(m_stream->tellg());
+
+	num_ie = GetIndexU32(index, pos, byte_swap);
+	for (uint32_t i = 0; i < num_ie; ++i)
+	{
+		if (index.size() - pos < 12)
+		{
+			LOG_ERROR(eFileReadError, eWarning, "RLE row index is truncated, ignoring it\n");
+			return false;
+		}
+		uint32_t ie_idx = GetIndexU32(index, pos, byte_swap);
+		uint32_t data_offset = GetIndexU32(index, pos, byte_swap);
+		uint32_t num_rows = GetIndexU32(index, pos, byte_swap);
+
+		if (ie_idx >= NUM_IMAGE_ELEMENTS || !m_IE[ie_idx].m_isinitialized || m_IE[ie_idx].GetHeader(eEncoding) != eEncodingRLE ||
+			data_offset != m_IE[ie_idx].GetHeader(eOffsetToData) || num_rows != m_IE[ie_idx].GetHeight() || !row_offsets[ie_idx].empty() ||
+			(index.size() - pos) / 4 < num_rows)
+		{
+			LOG_ERROR(eFileReadError, eWarning, "RLE row index does not match the image elements in the file, ignoring it\n");
+			return false;
+		}
+		for (uint32_t row = 0; row < num_rows; ++row)
+		{
+			uint32_t row_offset = GetIndexU32(index, pos, byte_swap);
+			if ((row == 0 && row_offset != data_offset) || (row > 0 && row_offset < row_offsets[ie_idx].back()) || row_offset >= file_size)
+			{
+				LOG_ERROR(eFileReadError, eWarning, "RLE row index for image element " + std::to_string(ie_idx + 1) + " is not consistent with the file, ignoring it\n");
+				return false;
+			}
+			row_offsets[ie_idx].push_back(row_offset);
+		}
+	}
+	if (num_ie == 0)
+		return false;
+
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+	{
+		if (!row_offsets[ie_idx].empty())
+			m_IE[ie_idx].m_rle_row_offsets = row_offsets[ie_idx];
+	}
+	return true;
+}
+
+
+bool HdrDpxFile::IsByteSwapNeeded() const
+{
+	return (m_byteorder == eLSBF && m_machine_is_msbf) || (m_byteorder == eMSBF && !m_machine_is_msbf);
+}
+
+
+void HdrDpxFile::ReadSbmData(std::istream &is) const
+{
+	if (m_dpx_header.FileHeader.StandardsBasedMetadataOffset == UNDEFINED_U32)
+		return;		// Nothing to do, no standards-based metadata
+
+	is.seekg(m_dpx_header.FileHeader.StandardsBasedMetadataOffset, std::ios::beg);
+
+	is.read(m_dpx_sbmdata.SbmFormatDescriptor, 128);
+
+	unsigned char sizebytes[4];
+	is.read(reinterpret_cast<char *>(sizebytes), 4);
+
+	if (m_byteorder == eLSBF)
+		m_dpx_sbmdata.SbmLength = (sizebytes[3] << 24) | (sizebytes[2] << 16) | (sizebytes[1] << 8) | sizebytes[0];
+	else
+		m_dpx_sbmdata.SbmLength = (sizebytes[0] << 24) | (sizebytes[1] << 16) | (sizebytes[2] << 8) | sizebytes[3];
+
+	if (is.bad() || is.eof())
+	{
+		LOG_ERROR(eFileReadError, eWarning, "Error attempting to read standards-based data\n");
+		return;
+	}
+
+	// Check the length against the file size before allocating for it
+	std::streampos cur_ptr = is.tellg();
+	is.seekg(0, std::ios::end);
+	if (static_cast<std::streamoff>(cur_ptr) + static_cast<std::streamoff>(m_dpx_sbmdata.SbmLength) > is.tellg())
+	{
+		LOG_ERROR(eFileReadError, eWarning, "Error attempting to read standards-based data\n");
+		return;
+	}
+	is.seekg(cur_ptr);
+
+	m_dpx_sbmdata.SbmData.resize(m_dpx_sbmdata.SbmLength);
+	is.read(reinterpret_cast<char *>(m_dpx_sbmdata.SbmData.data()), m_dpx_sbmdata.SbmData.size());
+
+	if (is.bad() || is.eof())
+	{
+		LOG_ERROR(eFileReadError, eWarning, "Error attempting to read standards-based data\n");
+		return;
+	}
+}
+
+void HdrDpxFile::ReadSection(void (HdrDpxFile::*read_fn)(std::istream &) const) const
+{
+	if (!m_open_for_read)
+	{
+		// Close() loads the sections not accessed yet, so there is nothing left to read them from
+		LOG_ERROR(eFileReadError, eWarning, "User data or metadata of " + m_file_name + " is not available because the file is not open\n");
+		return;
+	}
+	// Put the read position back for any row reads in progress
+	std::streampos cur_ptr = m_stream->tellg();
+	(this->*read_fn)(*m_stream);
+	m_stream->clear();
+	m_stream->seekg(cur_ptr);
+}
+
+// The sections are mutable so that the const getters can load them on first access
+void HdrDpxFile::LoadUserData() const
+{
+	if (!m_userdata_pending)
+		return;
+	m_userdata_pending = false;
+	ReadSection(&HdrDpxFile::ReadUserData);
+}
+
+void HdrDpxFile::LoadSbmData() const
+{
+	if (!m_sbmdata_pending)
+		return;
+	m_sbmdata_pending = false;
+	ReadSection(&HdrDpxFile::ReadSbmData);
+}
+
+void HdrDpxFile::DiscardPendingSections()
+{
+	m_userdata_pending = false;
+	m_sbmdata_pending = false;
+}
+
+
+HdrDpxImageElement *HdrDpxFile::GetImageElement(uint8_t ie_idx)
+{
+	if (ie_idx < 0 || ie_idx > 7)
+	{
+		LOG_ERROR(eBadParameter, eFatal, "Image element number out of bounds\n");
+		return NULL;
+	}
+	if (!m_IE[ie_idx].m_isinitialized)
+	{
+		m_IE[ie_idx].Initialize(ie_idx, m_stream, &m_dpx_header, &m_filemap);
+		// Image elements cannot be added when the header is updated in place
+		if (m_header_update)
+			m_IE[ie_idx].LockHeader();
+	}
+	return &(m_IE[ie_idx]);
+}
+
+
+void HdrDpxFile::ByteSwapHeader(void)
+{
+	ByteSwap32(&(m_dpx_header.FileHeader.Magic));
+	ByteSwap32(&(m_dpx_header.FileHeader.ImageOffset));
+	ByteSwap32(&(m_dpx_header.FileHeader.FileSize));
+	ByteSwap32(&(m_dpx_header.FileHeader.DittoKey));
+	ByteSwap32(&(m_dpx_header.FileHeader.GenericSize));
+	ByteSwap32(&(m_dpx_header.FileHeader.IndustrySize));
+	ByteSwap32(&(m_dpx_header.FileHeader.UserSize));
+	ByteSwap32(&(m_dpx_header.FileHeader.EncryptKey));
+	ByteSwap32(&(m_dpx_header.FileHeader.StandardsBasedMetadataOffset));
+
+	ByteSwap16(&(m_dpx_header.ImageHeader.Orientation));
+	ByteSwap16(&(m_dpx_header.ImageHeader.NumberElements));
+	ByteSwap32(&(m_dpx_header.ImageHeader.PixelsPerLine));
+	ByteSwap32(&(m_dpx_header.ImageHeader.LinesPerElement));
+	ByteSwap32(&(m_dpx_header.ImageHeader.ChromaSubsampling));
+
+	for (int ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
 	{
 		ByteSwap32(&(m_dpx_header.ImageHeader.ImageElement[ie_idx].DataSign));
 		ByteSwap32(&(m_dpx_header.ImageHeader.ImageElement[ie_idx].LowData.d));
 		ByteSwap32(&(m_dpx_header.ImageHeader.ImageElement[ie_idx].LowQuantity));
 		ByteSwap32(&(m_dpx_header.ImageHeader.ImageElement[ie_idx].HighData.d));
 		ByteSwap32(&(m_dpx_header.ImageHeader.ImageElement[ie_idx].HighQuantity));
-		ByteSwap32(&(m_dpx_header.ImageHeader.ImageElement[ie_idx].DataOffset));
 		ByteSwap16(&(m_dpx_header.ImageHeader.ImageElement[ie_idx].Packing));
 		ByteSwap16(&(m_dpx_header.ImageHeader.ImageElement[ie_idx].Encoding));
 		ByteSwap32(&(m_dpx_header.ImageHeader.ImageElement[ie_idx].DataOffset));
@@ -338,11 +1290,37 @@ bool HdrDpxFile::ByteSwapToMachine(void)
 	{
 		ByteSwapHeader();
 		ByteSwapSbmHeader();
+		CorrectLegacyDataOffsets();
 		return(true);
 	}
 	return(false);
 }
 
+void HdrDpxFile::CorrectLegacyDataOffsets(void)
+{
+	// Earlier versions of this library swapped DataOffset twice, so files they wrote in the non-native byte order
+	// store it byte-reversed. Such an offset points past the end of the file, unless the file is very large.
+	const uint32_t file_size = m_dpx_header.FileHeader.FileSize;
+	bool corrected = false;
+
+	if (file_size == UNDEFINED_U32)
+		return;
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+	{
+		uint32_t data_offset = m_dpx_header.ImageHeader.ImageElement[ie_idx].DataOffset;
+		if (data_offset == UNDEFINED_U32 || data_offset < file_size)
+			continue;
+		ByteSwap32(&data_offset);
+		if (data_offset < file_size)
+		{
+			m_dpx_header.ImageHeader.ImageElement[ie_idx].DataOffset = data_offset;
+			corrected = true;
+		}
+	}
+	if (corrected)
+		LOG_ERROR(eFileReadError, eWarning, "Image element data offsets are stored byte-reversed, as written by earlier versions of this library\n");
+}
+
 
 bool HdrDpxFile::IsHdr(void) const
 {
@@ -355,6 +1333,7 @@ void HdrDpxFile::ComputeOffsets()
 	uint32_t min_offset = UNDEFINED_U32;
 
 	m_filemap.Reset();
+	m_filemap.SetAlignment(m_data_alignment);
 
 	// Fill in what is specified
 	m_filemap.AddRegion(0, sizeof(HDRDPXFILEFORMAT), 100);
@@ -373,7 +1352,17 @@ void HdrDpxFile::ComputeOffsets()
 	{
 		if (m_IE[ie_idx].m_isinitialized)
 		{
-			m_IE[ie_idx].ComputeWidthAndHeight();
+			m_IE[ie_idx].ComputeLayout();
+			if (m_IE[ie_idx].GetHeader(eEndOfLinePadding) == UNDEFINED_U32)
+			{
+				// Pad each row out to the next alignment boundary (RLE rows vary in length, so they are not padded)
+				uint32_t row_size = m_IE[ie_idx].GetRowSizeInBytes(false);
+				uint32_t padding = 0;
+				if (m_IE[ie_idx].GetHeader(eEncoding) != eEncodingRLE && row_size % m_data_alignment != 0)
+					padding = m_data_alignment - row_size % m_data_alignment;
+				m_IE[ie_idx].SetHeader(eEndOfLinePadding, padding);
+				m_IE[ie_idx].ComputeLayout();
+			}
 			data_offset = m_IE[ie_idx].GetHeader(eOffsetToData);
 			if (data_offset != UNDEFINED_U32)
 			{
@@ -381,7 +1370,8 @@ void HdrDpxFile::ComputeOffsets()
 				{
 					uint32_t est_size = static_cast<uint32_t>((1.0 + RLE_MARGIN) * m_IE[ie_idx].GetImageDataSizeInBytes());
 					m_filemap.AddRegion(data_offset, data_offset + est_size, ie_idx);
-					m_filemap.AddRLEIE(ie_idx, data_offset, est_size);
+					if (!m_buffer_rle)
+						m_filemap.AddRLEIE(ie_idx, data_offset, est_size);
 				}
 				else
 					m_filemap.AddRegion(data_offset, data_offset + m_IE[ie_idx].GetImageDataSizeInBytes(), ie_idx);
@@ -401,9 +1391,9 @@ void HdrDpxFile::ComputeOffsets()
 		}
 	}
 
-	// Lastly add first variable-size IE
+	// Lastly add first variable-size IE (buffered RLE IEs are placed when the file is closed)
 	uint8_t first_ie = 1;
-	for (uint8_t ie_idx = 0; ie_idx < 8; ++ie_idx)
+	for (uint8_t ie_idx = 0; ie_idx < 8 && !m_buffer_rle; ++ie_idx)
 	{
 		if (m_IE[ie_idx].m_isinitialized)
 		{
@@ -431,7 +1421,7 @@ void HdrDpxFile::ComputeOffsets()
 	}
 	if (m_dpx_header.FileHeader.ImageOffset == UNDEFINED_U32)
 		m_dpx_header.FileHeader.ImageOffset = min_offset;
-	if (m_dpx_header.FileHeader.ImageOffset != min_offset)
+	if (m_dpx_header.FileHeader.ImageOffset != min_offset && min_offset != UNDEFINED_U32)
 		LOG_ERROR(eBadParameter, eWarning, "Image offset in main header does not match smallest image element offset");
 
 	if (m_filemap.CheckCollisions())
@@ -505,158 +1495,834 @@ void HdrDpxFile::FillCoreFields()
 				return;
 			}
 
-			if (m_IE[ie_idx].GetHeader(eDataSign) == eDataSignUndefined)
-			{
-				LOG_ERROR(eMissingCoreField, eWarning, "Data sign for image element " + std::to_string(ie_idx + 1) + " not specified, assuming unsigned");
-				m_IE[ie_idx].SetHeader(eDataSign, eDataSignUnsigned);
-			}
-			if (std::isnan(m_IE[ie_idx].GetHeader(eReferenceLowDataCode)) || std::isnan(m_IE[ie_idx].GetHeader(eReferenceHighDataCode)))
-			{
-				if (m_IE[ie_idx].GetHeader(eBitDepth) < 32)
-				{
-					LOG_ERROR(eMissingCoreField, eWarning, "Data range for image element " + std::to_string(ie_idx + 1) + " not specified, assuming full range");
-					m_IE[ie_idx].SetHeader(eReferenceLowDataCode, 0);
-					m_IE[ie_idx].SetHeader(eReferenceHighDataCode, static_cast<float>((1 << m_dpx_header.ImageHeader.ImageElement[ie_idx].BitSize) - 1));
-				}
-				else  // Floating point samples
-				{
-					LOG_ERROR(eMissingCoreField, eWarning, "Data range for image element " + std::to_string(ie_idx + 1) + " not specified, assuming full range (maxval = 1.0)");
-					m_IE[ie_idx].SetHeader(eReferenceLowDataCode, (float)0.0);
-					m_IE[ie_idx].SetHeader(eReferenceHighDataCode, (float)1.0);
-				}
-			}
-		}
-		else {
-			// Set ununsed image elements to all 1's
-			ClearHeader(ie_idx);
-		}
-		if (m_IE[ie_idx].GetHeader(eTransferCharacteristic) == eTransferUndefined)
-		{
-			LOG_ERROR(eMissingCoreField, eWarning, "Transfer characteristic for image element " + std::to_string(ie_idx + 1) + " not specified");
-		}
-		if (m_IE[ie_idx].GetHeader(eColorimetricSpecification) == eColorimetricUndefined)
-		{
-			LOG_ERROR(eMissingCoreField, eWarning, "Colorimetric field for image element " + std::to_string(ie_idx + 1) + " not specified");
-		}
-		if (m_IE[ie_idx].GetHeader(ePacking) == ePackingUndefined)
-		{
-			LOG_ERROR(eMissingCoreField, eWarning, "Packing field not specified for image element " + std::to_string(ie_idx + 1) + ", assuming Packed");
-			m_IE[ie_idx].SetHeader(ePacking, ePackingPacked);
-		}
-		if (m_IE[ie_idx].GetHeader(eEncoding) == eEncodingUndefined)
+			if (m_IE[ie_idx].GetHeader(eDataSign) == eDataSignUndefined)
+			{
+				LOG_ERROR(eMissingCoreField, eWarning, "Data sign for image element " + std::to_string(ie_idx + 1) + " not specified, assuming unsigned");
+				m_IE[ie_idx].SetHeader(eDataSign, eDataSignUnsigned);
+			}
+			if (std::isnan(m_IE[ie_idx].GetHeader(eReferenceLowDataCode)) || std::isnan(m_IE[ie_idx].GetHeader(eReferenceHighDataCode)))
+			{
+				if (m_IE[ie_idx].GetHeader(eBitDepth) < 32)
+				{
+					LOG_ERROR(eMissingCoreField, eWarning, "Data range for image element " + std::to_string(ie_idx + 1) + " not specified, assuming full range");
+					m_IE[ie_idx].SetHeader(eReferenceLowDataCode, 0);
+					m_IE[ie_idx].SetHeader(eReferenceHighDataCode, static_cast<float>((1 << m_dpx_header.ImageHeader.ImageElement[ie_idx].BitSize) - 1));
+				}
+				else  // Floating point samples
+				{
+					LOG_ERROR(eMissingCoreField, eWarning, "Data range for image element " + std::to_string(ie_idx + 1) + " not specified, assuming full range (maxval = 1.0)");
+					m_IE[ie_idx].SetHeader(eReferenceLowDataCode, (float)0.0);
+					m_IE[ie_idx].SetHeader(eReferenceHighDataCode, (float)1.0);
+				}
+			}
+		}
+		else {
+			// Set ununsed image elements to all 1's
+			ClearHeader(ie_idx);
+		}
+		if (m_IE[ie_idx].GetHeader(eTransferCharacteristic) == eTransferUndefined)
+		{
+			LOG_ERROR(eMissingCoreField, eWarning, "Transfer characteristic for image element " + std::to_string(ie_idx + 1) + " not specified");
+		}
+		if (m_IE[ie_idx].GetHeader(eColorimetricSpecification) == eColorimetricUndefined)
+		{
+			LOG_ERROR(eMissingCoreField, eWarning, "Colorimetric field for image element " + std::to_string(ie_idx + 1) + " not specified");
+		}
+		if (m_IE[ie_idx].GetHeader(ePacking) == ePackingUndefined)
+		{
+			LOG_ERROR(eMissingCoreField, eWarning, "Packing field not specified for image element " + std::to_string(ie_idx + 1) + ", assuming Packed");
+			m_IE[ie_idx].SetHeader(ePacking, ePackingPacked);
+		}
+		if (m_IE[ie_idx].GetHeader(eEncoding) == eEncodingUndefined)
+		{
+			LOG_ERROR(eMissingCoreField, eWarning, "Encoding not specified for image element " + std::to_string(ie_idx + 1) + ", assuming uncompressed");
+			m_IE[ie_idx].SetHeader(eEncoding, eEncodingNoEncoding);		// No compression (default)
+		}
+		if (m_IE[ie_idx].GetHeader(eEndOfLinePadding) == UNDEFINED_U32 && !m_align_rows)
+		{
+			LOG_ERROR(eMissingCoreField, eWarning, "End of line padding not specified for image element " + std::to_string(ie_idx + 1) + ", assuming no padding");
+			m_IE[ie_idx].SetHeader(eEndOfLinePadding, 0);
+		}
+		if (m_IE[ie_idx].GetHeader(eEndOfImagePadding) == UNDEFINED_U32)
+		{
+			LOG_ERROR(eMissingCoreField, eWarning, "End of image padding not specified for image element " + std::to_string(ie_idx + 1) + ", assuming no padding");
+			m_IE[ie_idx].SetHeader(eEndOfImagePadding, 0);
+		}
+	}
+
+	// The encoding must be settled before the layout is computed
+	for (uint8_t ie_idx = 0; ie_idx < 8; ++ie_idx)
+		if (m_IE[ie_idx].m_isinitialized && m_IE[ie_idx].GetHeader(eEncoding) == eEncodingAuto)
+			m_IE[ie_idx].ChooseEncoding();
+	// The row index can only be sized once every RLE image element is known
+	PrepareRLERowIndex();
+	ComputeOffsets();
+}
+
+
+bool HdrDpxFile::DittoTemplateFits() const
+{
+	// The previous frame was written from the template, so any layout field that differs from it was changed by the caller
+	const HDRDPXFILEFORMAT &cur = m_dpx_header, &prev = m_ditto_previous;
+
+	if (cur.FileHeader.ImageOffset != prev.FileHeader.ImageOffset ||
+		cur.FileHeader.UserSize != prev.FileHeader.UserSize ||
+		cur.FileHeader.StandardsBasedMetadataOffset != prev.FileHeader.StandardsBasedMetadataOffset ||
+		m_dpx_sbmdata.SbmLength != m_ditto_sbm_length ||
+		cur.FileHeader.DatumMappingDirection != prev.FileHeader.DatumMappingDirection ||
+		cur.ImageHeader.NumberElements != prev.ImageHeader.NumberElements ||
+		cur.ImageHeader.PixelsPerLine != prev.ImageHeader.PixelsPerLine ||
+		cur.ImageHeader.LinesPerElement != prev.ImageHeader.LinesPerElement ||
+		cur.ImageHeader.ChromaSubsampling != prev.ImageHeader.ChromaSubsampling)
+		return false;
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+	{
+		const HDRDPX_IMAGEELEMENT &cur_ie = cur.ImageHeader.ImageElement[ie_idx], &prev_ie = prev.ImageHeader.ImageElement[ie_idx];
+		if (m_IE[ie_idx].m_isinitialized && !(m_ditto_ie_mask & (1 << ie_idx)))
+			return false;
+		if (cur_ie.Descriptor != prev_ie.Descriptor || cur_ie.BitSize != prev_ie.BitSize || cur_ie.Packing != prev_ie.Packing ||
+			cur_ie.Encoding != prev_ie.Encoding || cur_ie.DataOffset != prev_ie.DataOffset ||
+			cur_ie.EndOfLinePadding != prev_ie.EndOfLinePadding || cur_ie.EndOfImagePadding != prev_ie.EndOfImagePadding)
+			return false;
+	}
+	return true;
+}
+
+bool HdrDpxFile::HeaderEditedSinceDitto() const
+{
+	HDRDPXFILEFORMAT cur = m_dpx_header;
+
+	cur.FileHeader.DittoKey = m_ditto_previous.FileHeader.DittoKey;
+	cur.FilmHeader.FramePosition = m_ditto_previous.FilmHeader.FramePosition;
+	cur.TvHeader.TimeCode = m_ditto_previous.TvHeader.TimeCode;
+	return memcmp(&cur, &m_ditto_previous, sizeof(HDRDPXFILEFORMAT)) != 0;
+}
+
+void HdrDpxFile::ResetDittoLayout()
+{
+	// Fields the writer filled in for the previous frame go back to what the caller specified, unless the caller has changed them since
+	HDRDPXFILEFORMAT &cur = m_dpx_header;
+	const HDRDPXFILEFORMAT &prev = m_ditto_previous, &req = m_ditto_requested;
+
+	if (cur.FileHeader.ImageOffset == prev.FileHeader.ImageOffset)
+		cur.FileHeader.ImageOffset = req.FileHeader.ImageOffset;
+	if (cur.FileHeader.FileSize == prev.FileHeader.FileSize)
+		cur.FileHeader.FileSize = req.FileHeader.FileSize;
+	if (cur.FileHeader.StandardsBasedMetadataOffset == prev.FileHeader.StandardsBasedMetadataOffset)
+		cur.FileHeader.StandardsBasedMetadataOffset = req.FileHeader.StandardsBasedMetadataOffset;
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+	{
+		HDRDPX_IMAGEELEMENT &cur_ie = cur.ImageHeader.ImageElement[ie_idx];
+		if (cur_ie.DataOffset == prev.ImageHeader.ImageElement[ie_idx].DataOffset)
+			cur_ie.DataOffset = req.ImageHeader.ImageElement[ie_idx].DataOffset;
+		if (cur_ie.EndOfLinePadding == prev.ImageHeader.ImageElement[ie_idx].EndOfLinePadding)
+			cur_ie.EndOfLinePadding = req.ImageHeader.ImageElement[ie_idx].EndOfLinePadding;
+
+		// Image elements of the previous frame are written again unless the caller has cleared them
+		if ((m_ditto_ie_mask & (1 << ie_idx)) && !m_IE[ie_idx].m_isinitialized && cur_ie.Descriptor != eDescUndefined)
+			m_IE[ie_idx].Initialize(ie_idx, m_stream, &m_dpx_header, &m_filemap);
+	}
+}
+
+void HdrDpxFile::OpenForWriting(std::string filename)
+{
+	OpenForWriting(filename, false);
+}
+
+void HdrDpxFile::OpenForWriting(std::vector<uint8_t> &buffer)
+{
+	LoadUserData();
+	LoadSbmData();
+	buffer.clear();
+	m_owned_io.reset(new VectorIO(buffer));
+	UseStreamBuffer(new RandomAccessBuf(m_owned_io.get()), "[memory buffer]");
+	OpenStreamForWriting(false);
+}
+
+void HdrDpxFile::OpenForWriting(HdrDpxRandomAccessIO *io)
+{
+	LoadUserData();
+	LoadSbmData();
+	UseStreamBuffer(new RandomAccessBuf(io), "[application I/O]");
+	OpenStreamForWriting(false);
+}
+
+void HdrDpxFile::OpenForWriting(std::ostream &os)
+{
+	LoadUserData();
+	LoadSbmData();
+	m_owned_io.reset(new ForwardWriteIO(os));
+	UseStreamBuffer(new RandomAccessBuf(m_owned_io.get()), "[output stream]");
+	OpenStreamForWriting(false, true);
+}
+
+void HdrDpxFile::OpenForWriting(std::string filename, bool use_ditto_template)
+{
+	// Anything still to be loaded from a file that was read is written out with the new file
+	LoadUserData();
+	LoadSbmData();
+
+	m_file_stream.open(filename, std::ios::binary | std::ios::out);
+	m_stream = &m_file_stream;
+	m_file_name = filename;
+	OpenStreamForWriting(use_ditto_template);
+}
+
+void HdrDpxFile::OpenStreamForWriting(bool use_ditto_template, bool forward_only)
+{
+	bool byte_swap;
+
+	if (m_byteorder == eNativeByteOrder)
+		byte_swap = false;
+	else if (m_byteorder == eLSBF)
+		byte_swap = m_machine_is_msbf ? true : false;
+	else
+		byte_swap = m_machine_is_msbf ? false : true;
+
+	if (!*m_stream)
+	{
+		LOG_ERROR(eFileOpenError, eFatal, "Unable to open file " + m_file_name + " for output");
+		return;
+	}
+
+	m_has_read_header = false;
+	m_forward_only = forward_only;
+	bool ditto_requested = use_ditto_template && m_has_ditto_template && m_dpx_header.FileHeader.DittoKey == eDittoKeySame;
+	m_header_is_ditto = ditto_requested && DittoTemplateFits();
+	if (ditto_requested && !m_header_is_ditto)
+		ResetDittoLayout();
+	if (m_header_is_ditto)
+	{
+		if (HeaderEditedSinceDitto())
+			LOG_ERROR(eBadParameter, eWarning, "Header fields changed since the previous frame are not written because the ditto key is set (only the frame position and time code are)");
+
+		// Start from the header of the previous frame as it was before Close() filled in its sizes and RLE offsets
+		uint32_t frame_position = m_dpx_header.FilmHeader.FramePosition;
+		uint32_t time_code = m_dpx_header.TvHeader.TimeCode;
+		m_dpx_header = m_ditto_template;
+		m_dpx_header.FileHeader.DittoKey = eDittoKeySame;
+		m_dpx_header.FilmHeader.FramePosition = frame_position;
+		m_dpx_header.TvHeader.TimeCode = time_code;
+		m_filemap = m_ditto_filemap;
+		for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+			if (m_ditto_ie_mask & (1 << ie_idx))
+				m_IE[ie_idx].Initialize(ie_idx, m_stream, &m_dpx_header, &m_filemap);
+	}
+
+	if (m_header_is_ditto)
+		PrepareRLERowIndex();
+	for (int ie_idx = 0; ie_idx < 8; ++ie_idx)
+	{
+		m_IE[ie_idx].m_buffer_rle_rows = m_buffer_rle;
+		m_IE[ie_idx].m_optimal_rle = m_optimal_rle;
+	}
+	if (!m_header_is_ditto)
+	{
+		m_has_ditto_validation = false;
+		m_ditto_requested = m_dpx_header;
+		FillCoreFields();
+		// Maybe check if core fields are valid here?
+
+		m_has_ditto_template = (m_err.GetWorstSeverity() != eFatal);
+		m_ditto_template = m_dpx_header;
+		m_ditto_template.FileHeader.DittoKey = eDittoKeySame;
+		m_ditto_filemap = m_filemap;
+		m_ditto_ie_mask = 0;
+		for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+			if (m_IE[ie_idx].m_isinitialized)
+				m_ditto_ie_mask |= 1 << ie_idx;
+	}
+
+	if (m_stream->bad())
+	{
+		LOG_ERROR(eFileWriteError, eFatal, "Error writing DPX image data");
+		return;
+	}
+
+	if (m_forward_only)
+	{
+		// The output cannot be rewound, so the header and user data go out first and are final
+		std::string reason;
+		if (!ComputeFixedFileSize(reason))
+		{
+			LOG_ERROR(eBadParameter, eFatal, "Cannot write to a forward-only output because " + reason);
+			m_forward_only = false;
+			return;
+		}
+		WriteHeader();
+		WriteUserData();
+		WriteSbmData();
+		WriteLayoutGaps();
+	}
+
+	uint8_t *mapped_data = NULL;
+	if (m_mapped_writing && m_stream == &m_file_stream)
+		mapped_data = MapOutputFile();
+	if (m_preallocate && mapped_data == NULL && m_stream == &m_file_stream)
+		PreallocateOutputFile();
+
+	for (int ie_idx = 0; ie_idx<8; ++ie_idx)
+	{
+		if (m_IE[ie_idx].m_isinitialized)
+		{
+			// Image elements set up before the file was opened may still point at another stream
+			m_IE[ie_idx].Rebind(m_stream, &m_dpx_header, &m_filemap);
+			m_IE[ie_idx].m_mapped_data = mapped_data;
+			m_IE[ie_idx].OpenForWriting(byte_swap);
+		}
+	}
+
+
+	if (m_stream->bad())
+	{
+		LOG_ERROR(eFileWriteError, eFatal, "Error writing DPX image data");
+		m_file_stream.close();
+	}
+	m_open_for_write = true;
+	m_open_for_read = false;
+	m_is_header_locked = true;
+	m_file_is_hdr_version = true;
+}
+
+void HdrDpxFile::Close()
+{
+	if (m_header_update)
+		WriteHeaderUpdate();
+	if (m_open_for_write)
+	{
+		if (m_forward_only)
+			;   // No RLE image elements, and the header, user data and metadata have already been written
+		else if (m_buffer_rle)
+			WriteBufferedRLEImageElements();
+		else
+		{
+			// Get RLE offsets if needed
+			std::vector<uint32_t> data_offsets = m_filemap.GetRLEIEDataOffsets();
+			for (int ie_idx = 0; ie_idx < 8; ++ie_idx)
+				if (m_dpx_header.ImageHeader.ImageElement[ie_idx].Encoding == 1)
+					m_dpx_header.ImageHeader.ImageElement[ie_idx].DataOffset = data_offsets[ie_idx];
+		}
+
+		// Compute SBM header offset if auto mode enabled
+		if (m_dpx_header.FileHeader.StandardsBasedMetadataOffset == eSBMAutoLocate)
+		{
+			m_dpx_header.FileHeader.StandardsBasedMetadataOffset = static_cast<uint32_t>(m_stream->tellp());
+		}
+
+		if (m_write_rle_row_index && CopyToStringN(m_dpx_userdata.UserIdentification, 32) == RLE_ROW_INDEX_USERID)
+			EncodeRLERowIndex();
+		if (!m_forward_only)
+		{
+			WriteUserData();
+			WriteSbmData();
+		}
+
+		// Everything else has been written, so the file size is exact
+		m_stream->seekp(0, std::ios::end);
+		std::streamoff file_size = m_stream->tellp();
+		if (m_forward_only)
+		{
+			// The file size was written with the header, so pad up to it (sections not written are left as zeros)
+			static const char zeros[4096] = { 0 };
+			while (file_size >= 0 && file_size < static_cast<std::streamoff>(m_dpx_header.FileHeader.FileSize) && *m_stream)
+			{
+				std::streamoff count = std::min<std::streamoff>(sizeof(zeros), m_dpx_header.FileHeader.FileSize - file_size);
+				m_stream->write(zeros, count);
+				file_size += count;
+			}
+			if (m_stream->bad())
+				LOG_ERROR(eFileWriteError, eWarning, "Error writing DPX file to " + m_file_name);
+			else if (file_size != static_cast<std::streamoff>(m_dpx_header.FileHeader.FileSize))
+				LOG_ERROR(eFileWriteError, eWarning, "More data was written than the file size written in the header");
+		}
+		else
+		{
+			if (file_size >= 0 && file_size < static_cast<std::streamoff>(sizeof(HDRDPXFILEFORMAT)))
+				file_size = sizeof(HDRDPXFILEFORMAT);
+			if (file_size > 0 && file_size <= static_cast<std::streamoff>(UINT32_MAX - 1))
+				m_dpx_header.FileHeader.FileSize = static_cast<uint32_t>(file_size);
+			else
+				LOG_ERROR(eFileWriteError, eWarning, "Unable to determine the size of the file being written");
+			WriteHeader();
+		}
+
+		// A ditto frame written next is checked against this frame as it was written
+		m_ditto_previous = m_dpx_header;
+		m_ditto_sbm_length = m_dpx_sbmdata.SbmLength;
+	}
+	if (m_open_for_read || m_open_for_write)
+	{
+		// Nothing is read after closing (and the file or buffer may change), so load the sections not accessed yet
+		LoadUserData();
+		LoadSbmData();
+		if (m_buf_stream)
+		{
+			m_buf_stream.reset();
+			m_stream_buf.reset();
+			m_owned_io.reset();
+			m_stream = &m_file_stream;
+		}
+		m_file_stream.close();
+		m_forward_only = false;
+		m_header_update = false;
+		for (int ie_idx = 0; ie_idx < 8; ++ie_idx)
+			m_IE[ie_idx].m_isinitialized = false;
+		m_open_for_read = false;
+		m_open_for_write = false;
+		m_is_header_locked = false;
+		m_header_is_ditto = false;
+	}
+}
+
+void HdrDpxFile::WriteHeader()
+{
+	m_stream->seekp(0, std::ios::beg);
+	// Swap before writing header
+	if ((m_byteorder == eLSBF && m_machine_is_msbf) || (m_byteorder == eMSBF && !m_machine_is_msbf))
+		ByteSwapHeader();
+	m_stream->write((char *)&m_dpx_header, sizeof(HDRDPXFILEFORMAT));
+	if ((m_byteorder == eLSBF && m_machine_is_msbf) || (m_byteorder == eMSBF && !m_machine_is_msbf))
+		ByteSwapHeader();
+}
+
+void HdrDpxFile::WriteSbmData()
+{
+	if (m_dpx_header.FileHeader.StandardsBasedMetadataOffset == UNDEFINED_U32)
+		return;   // No standards-based metadata
+
+	m_stream->seekp(m_dpx_header.FileHeader.StandardsBasedMetadataOffset, std::ios::beg);
+	if ((m_byteorder == eLSBF && m_machine_is_msbf) || (m_byteorder == eMSBF && !m_machine_is_msbf))
+		ByteSwapSbmHeader();
+	m_stream->write(m_dpx_sbmdata.SbmFormatDescriptor, 128);
+	m_stream->write((char *)&m_dpx_sbmdata.SbmLength, 4);
+	if ((m_byteorder == eLSBF && m_machine_is_msbf) || (m_byteorder == eMSBF && !m_machine_is_msbf))
+		ByteSwapSbmHeader();
+	m_stream->write((char *)m_dpx_sbmdata.SbmData.data(), m_dpx_sbmdata.SbmData.size());
+}
+
+bool HdrDpxFile::ComputeFixedFileSize(std::string &reason)
+{
+	uint64_t file_size = sizeof(HDRDPXFILEFORMAT);
+
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+	{
+		if (!m_IE[ie_idx].m_isinitialized)
+			continue;
+		if (m_IE[ie_idx].GetHeader(eEncoding) == eEncodingRLE)
+		{
+			reason = "image element " + std::to_string(ie_idx + 1) + " is run-length encoded";
+			return false;
+		}
+		file_size = std::max<uint64_t>(file_size, static_cast<uint64_t>(m_IE[ie_idx].GetHeader(eOffsetToData)) + m_IE[ie_idx].GetImageDataSizeInBytes());
+	}
+	if (m_dpx_header.FileHeader.StandardsBasedMetadataOffset == eSBMAutoLocate)
+	{
+		reason = "the standards-based metadata is auto-located";
+		return false;
+	}
+	if (m_dpx_header.FileHeader.UserSize != 0 && m_dpx_header.FileHeader.UserSize != UNDEFINED_U32)
+		file_size = std::max<uint64_t>(file_size, sizeof(HDRDPXFILEFORMAT) + static_cast<uint64_t>(m_dpx_header.FileHeader.UserSize));
+	if (m_dpx_header.FileHeader.StandardsBasedMetadataOffset != UNDEFINED_U32)
+		file_size = std::max<uint64_t>(file_size, static_cast<uint64_t>(m_dpx_header.FileHeader.StandardsBasedMetadataOffset) + 132 + m_dpx_sbmdata.SbmData.size());
+	if (file_size > UINT32_MAX - 1)
+	{
+		reason = "the file is too large";
+		return false;
+	}
+	m_dpx_header.FileHeader.FileSize = static_cast<uint32_t>(file_size);
+	return true;
+}
+
+void HdrDpxFile::WriteLayoutGaps()
+{
+	std::vector<std::pair<uint64_t, uint64_t>> sections;
+
+	sections.push_back(std::make_pair(0, sizeof(HDRDPXFILEFORMAT)));
+	if (m_dpx_header.FileHeader.UserSize != 0 && m_dpx_header.FileHeader.UserSize != UNDEFINED_U32)
+		sections.push_back(std::make_pair(sizeof(HDRDPXFILEFORMAT), sizeof(HDRDPXFILEFORMAT) + static_cast<uint64_t>(m_dpx_header.FileHeader.UserSize)));
+	if (m_dpx_header.FileHeader.StandardsBasedMetadataOffset != UNDEFINED_U32)
+		sections.push_back(std::make_pair(m_dpx_header.FileHeader.StandardsBasedMetadataOffset, static_cast<uint64_t>(m_dpx_header.FileHeader.StandardsBasedMetadataOffset) + 132 + m_dpx_sbmdata.SbmData.size()));
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+		if (m_IE[ie_idx].m_isinitialized)
+			sections.push_back(std::make_pair(m_IE[ie_idx].GetHeader(eOffsetToData), static_cast<uint64_t>(m_IE[ie_idx].GetHeader(eOffsetToData)) + m_IE[ie_idx].GetImageDataSizeInBytes()));
+	std::sort(sections.begin(), sections.end());
+
+	// Nothing else writes the space between sections, and a forward-only output cannot move past it until it is written
+	uint64_t end = 0;
+	for (size_t i = 0; i <= sections.size(); ++i)
+	{
+		uint64_t next = (i < sections.size()) ? sections[i].first : m_dpx_header.FileHeader.FileSize;
+		if (next > end)
+			WriteZeros(end, next);
+		if (i < sections.size())
+			end = std::max(end, sections[i].second);
+	}
+}
+
+void HdrDpxFile::WriteZeros(uint64_t start, uint64_t end)
+{
+	static const char zeros[4096] = { 0 };
+
+	m_stream->seekp(start, std::ios::beg);
+	for (uint64_t pos = start; pos < end; pos += sizeof(zeros))
+		m_stream->write(zeros, static_cast<std::streamsize>(std::min<uint64_t>(sizeof(zeros), end - pos)));
+}
+
+bool HdrDpxFile::RefuseLayoutChange()
+{
+	if (!m_header_update)
+		return false;
+	LOG_ERROR(eHeaderLocked, eWarning, "Fields that locate or lay out the image data cannot be changed when updating a header in place");
+	return true;
+}
+
+uint64_t HdrDpxFile::NextSectionStart(uint64_t offset) const
+{
+	uint64_t next = UINT64_MAX;
+
+	if (m_dpx_header.FileHeader.ImageOffset != UNDEFINED_U32 && m_dpx_header.FileHeader.ImageOffset >= offset)
+		next = m_dpx_header.FileHeader.ImageOffset;
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+	{
+		uint32_t data_offset = m_dpx_header.ImageHeader.ImageElement[ie_idx].DataOffset;
+		if (m_IE[ie_idx].m_isinitialized && data_offset >= offset)
+			next = std::min<uint64_t>(next, data_offset);
+	}
+	if (m_file_is_hdr_version && m_dpx_header.FileHeader.StandardsBasedMetadataOffset != UNDEFINED_U32 &&
+		m_dpx_header.FileHeader.StandardsBasedMetadataOffset >= offset)
+		next = std::min<uint64_t>(next, m_dpx_header.FileHeader.StandardsBasedMetadataOffset);
+	return next;
+}
+
+void HdrDpxFile::WriteHeaderUpdate()
+{
+	// Rows may have been read, so start from a clean stream state
+	m_stream->clear();
+	m_stream->seekp(0, std::ios::end);
+	std::streamoff file_end = m_stream->tellp();
+	if (file_end < 0)
+	{
+		LOG_ERROR(eFileWriteError, eWarning, "Unable to determine the size of " + m_file_name + ", so its header was not updated");
+		return;
+	}
+
+	if (m_userdata_changed)
+	{
+		uint64_t user_size = 32 + m_dpx_userdata.UserData.size();
+		uint64_t user_end = sizeof(HDRDPXFILEFORMAT) + user_size;
+		if (user_end <= NextSectionStart(sizeof(HDRDPXFILEFORMAT)) && user_end <= UINT32_MAX - 1)
 		{
-			LOG_ERROR(eMissingCoreField, eWarning, "Encoding not specified for image element " + std::to_string(ie_idx + 1) + ", assuming uncompressed");
-			m_IE[ie_idx].SetHeader(eEncoding, eEncodingNoEncoding);		// No compression (default)
+			m_dpx_header.FileHeader.UserSize = static_cast<uint32_t>(user_size);
+			WriteUserData();
+			if (user_size < m_update_user_size)
+				WriteZeros(user_end, sizeof(HDRDPXFILEFORMAT) + static_cast<uint64_t>(m_update_user_size));
+			if (user_end > static_cast<uint64_t>(file_end))
+				file_end = static_cast<std::streamoff>(user_end);
 		}
-		if (m_IE[ie_idx].GetHeader(eEndOfLinePadding) == UNDEFINED_U32)
+		else
 		{
-			LOG_ERROR(eMissingCoreField, eWarning, "End of line padding not specified for image element " + std::to_string(ie_idx + 1) + ", assuming no padding");
-			m_IE[ie_idx].SetHeader(eEndOfLinePadding, 0);
+			LOG_ERROR(eFileWriteError, eWarning, "User data does not fit in front of the image data, so it was not updated");
+			m_dpx_header.FileHeader.UserSize = m_update_user_size;
 		}
-		if (m_IE[ie_idx].GetHeader(eEndOfImagePadding) == UNDEFINED_U32)
+	}
+
+	if (m_sbmdata_changed)
+	{
+		// Metadata added to a file without any goes at the end, where it is also free to grow
+		uint64_t sbm_offset = (m_update_sbm_size != 0) ? m_dpx_header.FileHeader.StandardsBasedMetadataOffset : static_cast<uint64_t>(file_end);
+		uint64_t sbm_end = sbm_offset + 132 + m_dpx_sbmdata.SbmData.size();
+		if (sbm_end <= NextSectionStart(sbm_offset + 1) && sbm_end <= UINT32_MAX - 1)
 		{
-			LOG_ERROR(eMissingCoreField, eWarning, "End of image padding not specified for image element " + std::to_string(ie_idx + 1) + ", assuming no padding");
-			m_IE[ie_idx].SetHeader(eEndOfImagePadding, 0);
+			m_dpx_header.FileHeader.StandardsBasedMetadataOffset = static_cast<uint32_t>(sbm_offset);
+			m_dpx_sbmdata.SbmLength = static_cast<uint32_t>(m_dpx_sbmdata.SbmData.size());
+			WriteSbmData();
+			if (sbm_end < sbm_offset + m_update_sbm_size)
+				WriteZeros(sbm_end, sbm_offset + m_update_sbm_size);
+			if (sbm_end > m_dpx_header.FileHeader.FileSize)
+				m_dpx_header.FileHeader.FileSize = static_cast<uint32_t>(sbm_end);
 		}
+		else
+			LOG_ERROR(eFileWriteError, eWarning, "Standards-based metadata does not fit in front of the image data that follows it, so it was not updated");
 	}
-	ComputeOffsets();
-}
 
+	WriteHeader();
+	if (m_stream->bad())
+		LOG_ERROR(eFileWriteError, eWarning, "Error updating the header of " + m_file_name);
+}
 
-void HdrDpxFile::OpenForWriting(std::string filename)
+// Byte swap each 32-bit word in place. The loop is left to the compiler to vectorize.
+static void ByteSwapWords(uint8_t *data, size_t size)
 {
-	bool byte_swap;
-
-	m_file_stream.open(filename, std::ios::binary | std::ios::out);
+	for (size_t pos = 0; pos + 4 <= size; pos += 4)
+	{
+		uint32_t word;
+		memcpy(&word, data + pos, 4);
+		word = (word << 24) | ((word & 0xff00) << 8) | ((word >> 8) & 0xff00) | (word >> 24);
+		memcpy(data + pos, &word, 4);
+	}
+}
 
-	if (m_byteorder == eNativeByteOrder)
-		byte_swap = false;
-	else if (m_byteorder == eLSBF)
-		byte_swap = m_machine_is_msbf ? true : false;
-	else
-		byte_swap = m_machine_is_msbf ? false : true;
+void HdrDpxFile::ConvertByteOrder(std::string filename, HdrDpxByteOrder byte_order)
+{
+	const size_t chunk_size = 1 << 20;
+	std::vector<std::pair<uint64_t, uint64_t>> swap_ranges;
+	std::vector<uint8_t> buf;
 
-	m_file_name = filename;
-	
-	if (!m_file_stream)
+	if (!m_open_for_read)
 	{
-		LOG_ERROR(eFileOpenError, eFatal, "Unable to open file " + filename + " for output");
+		LOG_ERROR(eBadParameter, eWarning, "A file must be open for reading to convert its byte order");
 		return;
 	}
+	if (byte_order == eNativeByteOrder)
+		byte_order = m_machine_is_msbf ? eMSBF : eLSBF;
 
-	FillCoreFields();
-	// Maybe check if core fields are valid here?
-
-	if (m_file_stream.bad())
+	std::ofstream os(filename, std::ios::binary | std::ios::out | std::ios::trunc);
+	if (!os)
 	{
-		LOG_ERROR(eFileWriteError, eFatal, "Error writing DPX image data");
+		LOG_ERROR(eFileOpenError, eFatal, "Unable to open file " + filename + " for writing");
 		return;
 	}
 
-	for (int ie_idx = 0; ie_idx<8; ++ie_idx)
+	// Put the read position back afterwards for any row reads in progress
+	LoadUserData();
+	m_stream->clear();
+	std::streampos read_pos = m_stream->tellg();
+	m_stream->seekg(0, std::ios::end);
+	const uint64_t file_end = static_cast<uint64_t>(m_stream->tellg());
+
+	// The words to swap, as (start, end) ranges; everything else in the file is copied as is
+	if (byte_order != m_byteorder)
 	{
-		if (m_IE[ie_idx].m_isinitialized)
+		for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
 		{
-			m_IE[ie_idx].OpenForWriting(byte_swap);
+			if (!m_IE[ie_idx].m_isinitialized)
+				continue;
+			const HdrDpxImageElementLayout &layout = m_IE[ie_idx].m_layout;
+			uint64_t start = m_dpx_header.ImageHeader.ImageElement[ie_idx].DataOffset;
+			// The end of RLE data is not recorded, but nothing else is stored before the next section
+			uint64_t end = layout.is_rle ? NextSectionStart(start + 1) : start + static_cast<uint64_t>(layout.row_stride_bytes) * layout.height;
+			swap_ranges.push_back(std::make_pair(start, std::min(end, file_end)));
 		}
+		if (m_has_rle_row_index)
+			swap_ranges.push_back(std::make_pair(sizeof(HDRDPXFILEFORMAT) + 32, sizeof(HDRDPXFILEFORMAT) + static_cast<uint64_t>(m_dpx_header.FileHeader.UserSize)));
+		if (m_file_is_hdr_version && m_dpx_header.FileHeader.StandardsBasedMetadataOffset != UNDEFINED_U32)
+			swap_ranges.push_back(std::make_pair(m_dpx_header.FileHeader.StandardsBasedMetadataOffset + 128ull, m_dpx_header.FileHeader.StandardsBasedMetadataOffset + 132ull));
+		std::sort(swap_ranges.begin(), swap_ranges.end());
 	}
 
+	// The header is serialized as WriteHeader() would for the new byte order
+	HdrDpxByteOrder file_byte_order = m_byteorder;
+	m_byteorder = byte_order;
+	if (IsByteSwapNeeded())
+		ByteSwapHeader();
+	os.write((char *)&m_dpx_header, sizeof(HDRDPXFILEFORMAT));
+	if (IsByteSwapNeeded())
+		ByteSwapHeader();
+	m_byteorder = file_byte_order;
 
-	if (m_file_stream.bad())
-	{
-		LOG_ERROR(eFileWriteError, eFatal, "Error writing DPX image data");
-		m_file_stream.close();
+	// Copy the rest of the file in large chunks, swapping the words of each range
+	uint64_t pos = sizeof(HDRDPXFILEFORMAT);
+	auto copy_to = [&](uint64_t copy_end, bool swap) {
+		while (pos < copy_end && *m_stream)
+		{
+			size_t count = static_cast<size_t>(std::min<uint64_t>(chunk_size, copy_end - pos));
+			buf.resize(count);
+			m_stream->read((char *)buf.data(), count);
+			if (swap)
+				ByteSwapWords(buf.data(), count);
+			os.write((char *)buf.data(), count);
+			pos += count;
+		}
+	};
+	m_stream->seekg(pos, std::ios::beg);
+	for (auto &range : swap_ranges)
+	{
+		uint64_t start = range.first;
+		uint64_t end = std::min(range.second, file_end);
+		// Words stay aligned to the start of their range if it overlaps what has been copied already
+		if (start < pos)
+			start += (pos - start + 3) / 4 * 4;
+		if (start >= end)
+			continue;
+		copy_to(start, false);
+		copy_to(start + (end - start) / 4 * 4, true);
 	}
-	m_open_for_write = true;
-	m_open_for_read = false;
-	m_is_header_locked = true;
-	m_file_is_hdr_version = true;
+	copy_to(file_end, false);
+	if (!*m_stream || pos != file_end)
+		LOG_ERROR(eFileReadError, eWarning, "Error reading " + m_file_name + " to convert its byte order");
+	if (!os)
+		LOG_ERROR(eFileWriteError, eWarning, "Error writing " + filename);
+	m_stream->clear();
+	m_stream->seekg(read_pos);
 }
 
-void HdrDpxFile::Close()
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define HAVE_COPY_FILE_RANGE
+#endif
+
+// Copy part of one file into another within the kernel, which can share the blocks instead of copying them (e.g., on XFS or Btrfs)
+static bool CopyFileRange(const std::string &src_name, uint64_t src_offset, const std::string &dst_name, uint64_t dst_offset, uint64_t size)
+{
+#ifdef HAVE_COPY_FILE_RANGE
+	int src_fd = open(src_name.c_str(), O_RDONLY);
+	int dst_fd = open(dst_name.c_str(), O_WRONLY);
+	loff_t src_pos = static_cast<loff_t>(src_offset);
+	loff_t dst_pos = static_cast<loff_t>(dst_offset);
+	bool ok = (src_fd >= 0 && dst_fd >= 0);
+	while (ok && size > 0)
+	{
+		ssize_t count = copy_file_range(src_fd, &src_pos, dst_fd, &dst_pos, static_cast<size_t>(std::min<uint64_t>(size, 1 << 30)), 0);
+		ok = (count > 0);   // 0 means the source ended early
+		if (ok)
+			size -= count;
+	}
+	if (src_fd >= 0)
+		close(src_fd);
+	if (dst_fd >= 0)
+		close(dst_fd);
+	return ok;
+#else
+	return false;
+#endif
+}
+
+bool HdrDpxFile::CopyImageElementRaw(HdrDpxFile &src_file, uint8_t src_ie, uint8_t dst_ie)
 {
-	if (m_open_for_write)
+	const size_t chunk_size = 1 << 20;
+	std::vector<uint8_t> buf;
+
+	if (!m_open_for_write || dst_ie >= NUM_IMAGE_ELEMENTS || !m_IE[dst_ie].m_isinitialized)
 	{
-		// Compute SBM header offset if auto mode enabled
-		if (m_dpx_header.FileHeader.StandardsBasedMetadataOffset == eSBMAutoLocate)
+		LOG_ERROR(eBadParameter, eWarning, "Image data can only be copied to an image element of a file open for writing");
+		return false;
+	}
+	if (!src_file.m_open_for_read || src_ie >= NUM_IMAGE_ELEMENTS || !src_file.m_IE[src_ie].m_isinitialized)
+	{
+		LOG_ERROR(eBadParameter, eWarning, "Image data can only be copied from an image element of a file open for reading");
+		return false;
+	}
+	const HdrDpxImageElementLayout &src = src_file.m_IE[src_ie].m_layout;
+	const HdrDpxImageElementLayout &dst = m_IE[dst_ie].m_layout;
+	if (src.is_rle || dst.is_rle)
+	{
+		LOG_ERROR(eBadParameter, eInformational, "Run-length encoded image data cannot be copied without decoding it");
+		return false;
+	}
+	if (src.descriptor != dst.descriptor || src.bit_depth != dst.bit_depth || src.packing != dst.packing || src.width != dst.width ||
+		src.height != dst.height || src.direction_r2l != dst.direction_r2l || src.row_size_bytes != dst.row_size_bytes ||
+		src_file.IsByteSwapNeeded() != IsByteSwapNeeded())
+	{
+		LOG_ERROR(eBadParameter, eInformational, "Image element " + std::to_string(dst_ie + 1) + " does not have the same layout as the image element copied to it, so its rows must be decoded");
+		return false;
+	}
+	if (dst.height == 0)
+		return true;
+
+	// Without end-of-line padding differences, the rows form a single block
+	const bool same_stride = (src.row_stride_bytes == dst.row_stride_bytes);
+	const uint64_t src_offset = src_file.m_dpx_header.ImageHeader.ImageElement[src_ie].DataOffset;
+	const uint64_t dst_offset = m_dpx_header.ImageHeader.ImageElement[dst_ie].DataOffset;
+	const uint64_t data_size = static_cast<uint64_t>(dst.row_stride_bytes) * (dst.height - 1) + dst.row_size_bytes;
+	bool copied = false;
+	if (same_stride && !src_file.m_buf_stream && !m_buf_stream)
+	{
+		m_file_stream.flush();
+		copied = CopyFileRange(src_file.m_file_name, src_offset, m_file_name, dst_offset, data_size);
+	}
+	if (!copied)
+	{
+		// Put the read position back afterwards for any row reads in progress
+		src_file.m_stream->clear();
+		std::streampos read_pos = src_file.m_stream->tellg();
+		const uint32_t num_blocks = same_stride ? 1 : dst.height;
+		const uint64_t block_size = same_stride ? data_size : dst.row_size_bytes;
+		for (uint32_t block = 0; block < num_blocks && *src_file.m_stream; ++block)
 		{
-			m_dpx_header.FileHeader.StandardsBasedMetadataOffset = static_cast<uint32_t>(m_file_stream.tellp());
+			src_file.m_stream->seekg(src_offset + static_cast<uint64_t>(block) * src.row_stride_bytes, std::ios::beg);
+			m_stream->seekp(dst_offset + static_cast<uint64_t>(block) * dst.row_stride_bytes, std::ios::beg);
+			for (uint64_t pos = 0; pos < block_size && *src_file.m_stream; pos += chunk_size)
+			{
+				size_t count = static_cast<size_t>(std::min<uint64_t>(chunk_size, block_size - pos));
+				buf.resize(count);
+				src_file.m_stream->read((char *)buf.data(), count);
+				m_stream->write((char *)buf.data(), count);
+			}
 		}
-
-		// Get RLE offsets if needed
-		std::vector<uint32_t> data_offsets = m_filemap.GetRLEIEDataOffsets();
-		for (int ie_idx = 0; ie_idx < 8; ++ie_idx)
-			if (m_dpx_header.ImageHeader.ImageElement[ie_idx].Encoding == 1)
-				m_dpx_header.ImageHeader.ImageElement[ie_idx].DataOffset = data_offsets[ie_idx];
-
-		m_file_stream.seekp(0, std::ios::beg);
-		// Swap before writing header
-		if ((m_byteorder == eLSBF && m_machine_is_msbf) || (m_byteorder == eMSBF && !m_machine_is_msbf))
-			ByteSwapHeader();
-		m_file_stream.write((char *)&m_dpx_header, sizeof(HDRDPXFILEFORMAT));
-		if ((m_byteorder == eLSBF && m_machine_is_msbf) || (m_byteorder == eMSBF && !m_machine_is_msbf))
-			ByteSwapHeader();
-
-		if (m_dpx_header.FileHeader.StandardsBasedMetadataOffset != UNDEFINED_U32)
+		if (!*src_file.m_stream)
 		{
-			// Write standards-based metadata
-			m_file_stream.seekp(m_dpx_header.FileHeader.StandardsBasedMetadataOffset, std::ios::beg);
-			if ((m_byteorder == eLSBF && m_machine_is_msbf) || (m_byteorder == eMSBF && !m_machine_is_msbf))
-				ByteSwapSbmHeader();
-			m_file_stream.write((char *)&m_dpx_sbmdata, 132 + m_dpx_sbmdata.SbmLength);
-			if ((m_byteorder == eLSBF && m_machine_is_msbf) || (m_byteorder == eMSBF && !m_machine_is_msbf))
-				ByteSwapSbmHeader();
+			LOG_ERROR(eFileReadError, eWarning, "Error reading image element " + std::to_string(src_ie + 1) + " of " + src_file.m_file_name);
+			src_file.m_stream->clear();
+			src_file.m_stream->seekg(read_pos);
+			return false;
 		}
+		src_file.m_stream->seekg(read_pos);
 	}
-	if (m_open_for_read || m_open_for_write)
+
+	// Finish as if the last row had been written
+	if (!m_IE[dst_ie].IsWrittenToMapping())
 	{
-		m_file_stream.close();
-		for (int ie_idx = 0; ie_idx < 8; ++ie_idx)
-			m_IE[ie_idx].m_isinitialized = false;
-		m_open_for_read = false;
-		m_open_for_write = false;
-		m_is_header_locked = false;
+		m_stream->seekp(dst_offset + data_size, std::ios::beg);
+		m_IE[dst_ie].WriteEndOfImagePadding();
 	}
+	if (m_stream->bad())
+	{
+		LOG_ERROR(eFileWriteError, eWarning, "Error writing image element " + std::to_string(dst_ie + 1) + " to " + m_file_name);
+		return false;
+	}
+	return true;
+}
+
+void HdrDpxFile::PreallocateOutputFile()
+{
+	std::string reason;
+	if (!ComputeFixedFileSize(reason))
+	{
+		LOG_ERROR(eFileWriteError, eInformational, "Not preallocating " + m_file_name + " because " + reason);
+		return;
+	}
+	// The allocation does not change the size of the file, which still only grows as data is written
+	bool ok = false;
+#ifdef _WIN32
+	HANDLE file = CreateFileA(m_file_name.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file != INVALID_HANDLE_VALUE)
+	{
+		FILE_ALLOCATION_INFO info;
+		info.AllocationSize.QuadPart = m_dpx_header.FileHeader.FileSize;
+		ok = SetFileInformationByHandle(file, FileAllocationInfo, &info, sizeof(info)) != 0;
+		CloseHandle(file);
+	}
+#elif defined(__linux__)
+	int fd = open(m_file_name.c_str(), O_WRONLY);
+	if (fd >= 0)
+	{
+		ok = (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(m_dpx_header.FileHeader.FileSize)) == 0);
+		close(fd);
+	}
+#endif
+	if (!ok)
+		LOG_ERROR(eFileWriteError, eInformational, "Unable to preallocate " + m_file_name);
+}
+
+uint8_t *HdrDpxFile::MapOutputFile()
+{
+	std::string reason;
+	if (!ComputeFixedFileSize(reason))
+	{
+		LOG_ERROR(eFileWriteError, eInformational, "Writing " + m_file_name + " without a memory mapping because " + reason);
+		return NULL;
+	}
+	std::unique_ptr<MappedFileIO> io(new MappedFileIO(m_file_name, m_dpx_header.FileHeader.FileSize));
+	if (io->GetData() == NULL)
+	{
+		LOG_ERROR(eFileWriteError, eInformational, "Writing " + m_file_name + " without a memory mapping because it could not be mapped");
+		return NULL;
+	}
+	// The mapping replaces the file stream, which has already created the file
+	uint8_t *data = io->GetData();
+	m_file_stream.close();
+	m_owned_io = std::move(io);
+	UseStreamBuffer(new RandomAccessBuf(m_owned_io.get()), m_file_name);
+	return data;
 }
 
 static std::string u32_to_hex(uint32_t value)
@@ -808,6 +2474,7 @@ std::string HdrDpxFile::DumpHeader() const
 	if (m_dpx_header.FileHeader.UserSize > 0 && m_dpx_header.FileHeader.UserSize != UNDEFINED_U32)
 	{
 		header += "\n// User data header\n";
+		LoadUserData();
 		PRINT_FIELD_ASCII(std::string("User_Identification"), m_dpx_userdata.UserIdentification, 32);
 		// Read user data and print
 		std::string userid;
@@ -833,6 +2500,7 @@ std::string HdrDpxFile::DumpHeader() const
 	if (m_dpx_header.FileHeader.StandardsBasedMetadataOffset != UNDEFINED_U32)
 	{
 		header += "\n// Standards-based metadata header\n";
+		LoadSbmData();
 		PRINT_FIELD_ASCII(std::string("Sbm_Descriptor"), m_dpx_sbmdata.SbmFormatDescriptor, 128);
 		PRINT_FIELD_U32(std::string("Sbm_Length"), m_dpx_sbmdata.SbmLength);
 		// Read standards-based metadata & print
@@ -939,9 +2607,16 @@ static bool ValidateTimeDate(std::string s, std::string &errmsg)
 bool HdrDpxFile::Validate()
 {
 	std::string errmsg;
+	unsigned int first_error = m_err.GetNumErrors();
+
+	// A ditto frame shares all but a few fields with the frame that was validated last
+	if (m_header_is_ditto && m_has_ditto_validation)
+	{
+		m_err += m_ditto_validation;
+		ValidateFrameFields();
+		return m_err.GetWorstSeverity() != eInformational;
+	}
 
-	if(GetHeader(eDittoKey) > eDittoKeySame && GetHeader(eDittoKey) != eDittoKeyUndefined)
-		LOG_ERROR(eValidationError, eWarning, "Ditto Key field has invalid value");
 	if(GetHeader(eGenericSectionHeaderLength) != 1664)
 		LOG_ERROR(eValidationError, eWarning, "Generic Size field has invalid value");
 	if(GetHeader(eIndustrySpecificHeaderLength) != 384)
@@ -1044,8 +2719,6 @@ bool HdrDpxFile::Validate()
 		}
 		if (m_IE[ie_idx].GetHeader(eEncoding) > eEncodingRLE)
 			LOG_ERROR(eValidationError, eWarning, "Encoding core field is invalid\n");
-		if (m_IE[ie_idx].GetHeader(eOffsetToData) != UNDEFINED_U32 && (m_IE[ie_idx].GetHeader(eOffsetToData) & 3))
-			LOG_ERROR(eValidationError, eWarning, "Offset to data is required to be multiple of 4\n");
 		if (m_IE[ie_idx].GetHeader(eEndOfLinePadding) & 3)
 			LOG_ERROR(eValidationError, eWarning, "End of line padding is required to be multiple of 4\n");
 		if ((m_IE[ie_idx].GetHeader(eEndOfImagePadding) & 3) && m_IE[ie_idx].GetHeader(eEndOfImagePadding) != UNDEFINED_U32)
@@ -1091,9 +2764,6 @@ bool HdrDpxFile::Validate()
 		LOG_ERROR(eValidationError, eWarning, "Count field is all 0xff bytes; undefined strings should use single null character");
 	if (WARN_FOR_ALL_FF_STRINGS && IsStringAllFs(GetHeader(eFormat), 32))
 		LOG_ERROR(eValidationError, eWarning, "Format field is all 0xff bytes; undefined strings should use single null character");
-	if (GetHeader(eFramePositionInSequence) != UNDEFINED_U32 && GetHeader(eSequenceLength) != UNDEFINED_U32 &&
-		GetHeader(eFramePositionInSequence) > GetHeader(eSequenceLength))
-		LOG_ERROR(eValidationError, eWarning, "Frame position field is larger than sequence length field");
 	// No validation for Held count, frame rate of original, shutter angle
 	if (WARN_FOR_ALL_FF_STRINGS && IsStringAllFs(GetHeader(eFrameIdentification), 32))
 		LOG_ERROR(eValidationError, eWarning, "Frame identification field is all 0xff bytes; undefined strings should use single null character");
@@ -1125,17 +2795,42 @@ bool HdrDpxFile::Validate()
 		!(GetHeader(eVideoIdentificationCode) >= eVIC_2160p2x120 && GetHeader(eVideoIdentificationCode) <= eVIC_4096x2160p120))
 		LOG_ERROR(eValidationError, eWarning, "Video identification code (VIC) field has unrecognized value");
 
-	
-	if (m_filemap.CheckCollisions())
-		LOG_ERROR(eValidationError, eWarning, "Image map has potentially overlapping regions");
-	//ComputeOffsets();   // Checks file map
-
 	// Do we need any other validation warnings/info?
 
+	m_ditto_validation.Clear();
+	for (unsigned int i = first_error; i < m_err.GetNumErrors(); ++i)
+	{
+		ErrorCode code;
+		ErrorSeverity severity;
+		m_err.GetError(i, code, severity, errmsg);
+		m_ditto_validation.LogError(code, severity, errmsg);
+	}
+	m_has_ditto_validation = true;
 
+	ValidateFrameFields();
 	return m_err.GetWorstSeverity() != eInformational;
 }
 
+void HdrDpxFile::ValidateFrameFields()
+{
+	if(GetHeader(eDittoKey) > eDittoKeyNew && GetHeader(eDittoKey) != eDittoKeyUndefined)
+		LOG_ERROR(eValidationError, eWarning, "Ditto Key field has invalid value");
+	for (auto ie_idx : GetIEIndexList())
+	{
+		if (m_IE[ie_idx].GetHeader(eDescriptor) == eDescUndefined)   // indicates the IE is not present
+			continue;
+		if (m_IE[ie_idx].GetHeader(eOffsetToData) != UNDEFINED_U32 && (m_IE[ie_idx].GetHeader(eOffsetToData) & 3))
+			LOG_ERROR(eValidationError, eWarning, "Offset to data is required to be multiple of 4\n");
+	}
+	if (GetHeader(eFramePositionInSequence) != UNDEFINED_U32 && GetHeader(eSequenceLength) != UNDEFINED_U32 &&
+		GetHeader(eFramePositionInSequence) > GetHeader(eSequenceLength))
+		LOG_ERROR(eValidationError, eWarning, "Frame position field is larger than sequence length field");
+
+	if (m_filemap.CheckCollisions())
+		LOG_ERROR(eValidationError, eWarning, "Image map has potentially overlapping regions");
+	//ComputeOffsets();   // Checks file map
+}
+
 std::size_t utf8_length(const std::string &utf8_string)
 {
 	std::size_t result = 0;
@@ -1233,22 +2928,31 @@ void HdrDpxFile::SetHeader(HdrDpxFieldsString field, const std::string &value)
 			m_warn_messages.push_back("SetHeader(): Specified slate info (" + value + ") exceeds header field size\n");
 		break;
 	case eUserIdentification:
+		LoadUserData();
+		m_userdata_changed = true;
 		if (CopyStringN(m_dpx_userdata.UserIdentification, value, 32))
 			m_warn_messages.push_back("SetHeader(): Specified user identification (" + value + ") exceeds header field size\n");
 		break;
 	case eUserDefinedData:
+		LoadUserData();
+		m_userdata_changed = true;
 		length = utf8_length(value);
 		m_dpx_userdata.UserData.resize(length);
 		memcpy(m_dpx_userdata.UserData.data(), value.data(), length);
 		break;
 	case eSBMFormatDescriptor:
+		LoadSbmData();
+		m_sbmdata_changed = true;
 		if (CopyStringN(m_dpx_sbmdata.SbmFormatDescriptor, value, 128))
 			m_warn_messages.push_back("SetHeader(): Specified SBM format descriptor (" + value + ") exceeds header field size\n");
 		break;
 	case eSBMetadata:
+		LoadSbmData();
+		m_sbmdata_changed = true;
 		length = utf8_length(value);
 		m_dpx_sbmdata.SbmData.resize(length);
 		memcpy(m_dpx_sbmdata.SbmData.data(), value.data(), length);
+		m_dpx_sbmdata.SbmLength = static_cast<uint32_t>(length);
 		break;
 	}
 }
@@ -1293,14 +2997,18 @@ std::string HdrDpxFile::GetHeader(HdrDpxFieldsString field) const
 	case eSlateInformation:
 		return CopyToStringN(m_dpx_header.FilmHeader.SlateInfo, 100);
 	case eUserIdentification:
+		LoadUserData();
 		return CopyToStringN(m_dpx_userdata.UserIdentification, 32);
 	case eUserDefinedData:
+		LoadUserData();
 		if (!m_dpx_userdata.UserData.size())
 			return "";
 		return std::string((char *)m_dpx_userdata.UserData.data());
 	case eSBMFormatDescriptor:
+		LoadSbmData();
 		return CopyToStringN(m_dpx_sbmdata.SbmFormatDescriptor, 128);
 	case eSBMetadata:
+		LoadSbmData();
 		if (!m_dpx_sbmdata.SbmData.size())
 			return "";	
 		return std::string((char *)m_dpx_sbmdata.SbmData.data(), m_dpx_sbmdata.SbmLength);
@@ -1315,6 +3023,10 @@ void HdrDpxFile::SetHeader(HdrDpxFieldsU32 field, uint32_t value)
 		LOG_ERROR(eHeaderLocked, eWarning, "Attempted to change locked header field");
 		return;
 	}
+	if ((field == eOffsetToImageData || field == eTotalImageFileSize || field == eGenericSectionHeaderLength ||
+		field == eIndustrySpecificHeaderLength || field == eStandardsBasedMetadataOffset || field == ePixelsPerLine ||
+		field == eLinesPerImageElement) && RefuseLayoutChange())
+		return;
 	switch (field)
 	{
 	case eOffsetToImageData:
@@ -1419,6 +3131,7 @@ uint32_t HdrDpxFile::GetHeader(HdrDpxFieldsU32 field) const
 	case eHeldCount:
 		return(m_dpx_header.FilmHeader.HeldCount);
 	case eSBMLength:
+		LoadSbmData();
 		return(m_dpx_sbmdata.SbmLength);
 	}
 	return 0;
@@ -1431,6 +3144,8 @@ void HdrDpxFile::SetHeader(HdrDpxFieldsU16 field, uint16_t value)
 		LOG_ERROR(eHeaderLocked, eWarning, "Attempted to change locked header field");
 		return;
 	}
+	if (field == eNumberOfImageElements && RefuseLayoutChange())
+		return;
 	switch (field)
 	{
 	case eNumberOfImageElements:
@@ -1617,6 +3332,8 @@ void HdrDpxFile::SetHeader(HdrDpxFieldsDatumMappingDirection field, HdrDpxDatumM
 		LOG_ERROR(eHeaderLocked, eWarning, "Attempted to change locked header field");
 		return;
 	}
+	if (RefuseLayoutChange())
+		return;
 	m_dpx_header.FileHeader.DatumMappingDirection = static_cast<uint8_t>(value);
 }
 
@@ -1772,6 +3489,8 @@ void HdrDpxFile::SetHeader(HdrDpxFieldsByteOrder field, HdrDpxByteOrder value)
 		LOG_ERROR(eHeaderLocked, eWarning, "Attempted to change locked header field");
 		return;
 	}
+	if (RefuseLayoutChange())
+		return;
 	m_byteorder = value;
 }
 
@@ -1831,6 +3550,8 @@ void HdrDpxFile::SetUserData(std::string userid, std::vector<uint8_t> userdata)
 	}
 	CopyStringN(m_dpx_userdata.UserIdentification, userid, 32);
 	m_dpx_userdata.UserData = userdata;
+	m_userdata_pending = false;
+	m_userdata_changed = true;
 	m_dpx_header.FileHeader.UserSize = static_cast<DWORD>(userdata.size() + 32);
 }
 
@@ -1838,6 +3559,7 @@ bool HdrDpxFile::GetUserData(std::string &userid, std::vector<uint8_t> &userdata
 {
 	if (m_dpx_header.FileHeader.UserSize == 0)		// nothing to do
 		return false;
+	LoadUserData();
 	userid = CopyToStringN(m_dpx_userdata.UserIdentification, 32);
 	userdata = m_dpx_userdata.UserData;
 	return true;
@@ -1857,12 +3579,15 @@ void HdrDpxFile::SetStandardsBasedMetadata(std::string sbm_descriptor, std::vect
 	CopyStringN(m_dpx_sbmdata.SbmFormatDescriptor, sbm_descriptor, 128);
 	m_dpx_sbmdata.SbmData = sbmdata;
 	m_dpx_sbmdata.SbmLength = static_cast<uint32_t>(sbmdata.size());
+	m_sbmdata_pending = false;
+	m_sbmdata_changed = true;
 }
 
 bool HdrDpxFile::GetStandardsBasedMetadata(std::string &sbm_descriptor, std::vector<uint8_t> &sbmdata) const
 {
 	if (m_dpx_header.FileHeader.StandardsBasedMetadataOffset == UNDEFINED_U32)		// nothing to do
 		return false;
+	LoadSbmData();
 	sbm_descriptor = CopyToStringN(m_dpx_sbmdata.SbmFormatDescriptor, 128);
 	sbmdata = m_dpx_sbmdata.SbmData;
 	return true;
@@ -1912,7 +3637,13 @@ void HdrDpxFile::CopyHeaderFrom(const HdrDpxFile &src)
 		LOG_ERROR(eHeaderLocked, eWarning, "Can't copy header to locked file\n");
 		return;
 	}
+	if (RefuseLayoutChange())
+		return;
 	// Copy header, userdata, sbmdata from other file
+	src.LoadUserData();
+	src.LoadSbmData();
+	m_userdata_pending = false;
+	m_sbmdata_pending = false;
 	m_dpx_header = src.m_dpx_header;
 	m_dpx_sbmdata = src.m_dpx_sbmdata;
 	m_dpx_userdata = src.m_dpx_userdata;
@@ -1922,6 +3653,10 @@ void HdrDpxFile::ClearHeader(uint8_t ie_index)
 {
 	if (ie_index == 0xff)
 	{
+		m_has_read_header = false;
+		m_has_ditto_template = false;
+		m_userdata_pending = false;
+		m_sbmdata_pending = false;
 		memset(&m_dpx_header, 0xff, sizeof(HDRDPXFILEFORMAT));
 		SetHeader(eImageFileName, "");
 		SetHeader(eCreationDateTime, "");
@@ -1964,3 +3699,112 @@ void HdrDpxFile::DumpStandardsBasedMetedataOptions(bool dump_sbmd, HdrDpxDumpFor
 	m_sbm_dump = dump_sbmd;
 	m_sbm_dump_format = format;
 }
+
+void HdrDpxFile::EnableRLERowIndex(bool enable)
+{
+	if (m_open_for_write)
+	{
+		LOG_ERROR(eHeaderLocked, eWarning, "RLE row index must be enabled before the file is opened for writing");
+		return;
+	}
+	m_write_rle_row_index = enable;
+	m_has_ditto_template = false;   // the template's user data size depends on this
+}
+
+bool HdrDpxFile::HasRLERowIndex() const
+{
+	return m_has_rle_row_index;
+}
+
+void HdrDpxFile::EnableRLEBuffering(bool enable)
+{
+	if (m_open_for_write)
+	{
+		LOG_ERROR(eHeaderLocked, eWarning, "RLE buffering must be enabled before the file is opened for writing");
+		return;
+	}
+	m_buffer_rle = enable;
+	m_has_ditto_template = false;   // the template's file map depends on this
+}
+
+void HdrDpxFile::EnableSizeOptimalRLE(bool enable)
+{
+	if (m_open_for_write)
+	{
+		LOG_ERROR(eHeaderLocked, eWarning, "Size-optimal RLE must be enabled before the file is opened for writing");
+		return;
+	}
+	m_optimal_rle = enable;
+}
+
+void HdrDpxFile::SetDataAlignment(uint32_t alignment, bool align_rows)
+{
+	if (m_open_for_write)
+	{
+		LOG_ERROR(eHeaderLocked, eWarning, "Data alignment must be set before the file is opened for writing");
+		return;
+	}
+	if (alignment == 0)
+		alignment = 1;
+	if (alignment != 1 && alignment % 4 != 0)
+	{
+		LOG_ERROR(eBadParameter, eWarning, "Data alignment must be a multiple of 4 bytes");
+		return;
+	}
+	m_data_alignment = alignment;
+	m_align_rows = align_rows && alignment != 1;
+	m_has_ditto_template = false;   // the template's offsets depend on this
+}
+
+void HdrDpxFile::EnablePreallocation(bool enable)
+{
+	if (m_open_for_write)
+	{
+		LOG_ERROR(eHeaderLocked, eWarning, "Preallocation must be enabled before the file is opened for writing");
+		return;
+	}
+	m_preallocate = enable;
+}
+
+void HdrDpxFile::EnableMappedWriting(bool enable)
+{
+	if (m_open_for_write)
+	{
+		LOG_ERROR(eHeaderLocked, eWarning, "Memory-mapped writing must be enabled before the file is opened for writing");
+		return;
+	}
+	m_mapped_writing = enable;
+}
+
+void HdrDpxFile::WriteBufferedRLEImageElements()
+{
+	uint32_t min_offset = UNDEFINED_U32;
+
+	// Place each RLE IE now that its exact size is known; IEs without a specified offset go in the first gap that fits
+	for (uint8_t ie_idx = 0; ie_idx < 8; ++ie_idx)
+	{
+		if (!m_IE[ie_idx].m_isinitialized || m_dpx_header.ImageHeader.ImageElement[ie_idx].Encoding != 1)
+			continue;
+		uint32_t size = m_IE[ie_idx].GetBufferedRLESize();
+		uint32_t data_offset = m_dpx_header.ImageHeader.ImageElement[ie_idx].DataOffset;
+		if (data_offset == UNDEFINED_U32)
+			data_offset = m_filemap.FindEmptySpace(size, ie_idx);
+		else
+			m_filemap.EditRegionEnd(ie_idx, data_offset + size);
+		m_dpx_header.ImageHeader.ImageElement[ie_idx].DataOffset = data_offset;
+		m_IE[ie_idx].WriteBufferedRLERows();
+	}
+	if (m_filemap.CheckCollisions())
+		LOG_ERROR(eBadParameter, eWarning, "Image map has potentially overlapping regions");
+
+	for (uint8_t ie_idx = 0; ie_idx < 8; ++ie_idx)
+	{
+		if (m_IE[ie_idx].m_isinitialized && min_offset > m_dpx_header.ImageHeader.ImageElement[ie_idx].DataOffset)
+			min_offset = m_dpx_header.ImageHeader.ImageElement[ie_idx].DataOffset;
+	}
+	if (m_dpx_header.FileHeader.ImageOffset == UNDEFINED_U32 || m_dpx_header.FileHeader.ImageOffset > min_offset)
+		m_dpx_header.FileHeader.ImageOffset = min_offset;
+
+	// Leave the write pointer at the end of the image data (for auto-located standards-based metadata)
+	m_stream->seekp(0, std::ios::end);
+}
@@ -0,0 +1,136 @@
+/***************************************************************************
+*    Copyright (c) 2020, Broadcom Inc.
+*
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions are
+*  met:
+*
+*  1. Redistributions of source code must retain the above copyright notice,
+*     this list of conditions and the following disclaimer.
+*
+*  2. Redistributions in binary form must reproduce the above copyright
+*     notice, this list of conditions and the following disclaimer in the
+*     documentation and/or other materials provided with the distribution.
+*
+*  3. Neither the name of the copyright holder nor the names of its
+*     contributors may be used to endorse or promote products derived from
+*     this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+*  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+*  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+*  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+*  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+*  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+*  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+*  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+*  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+*  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+*  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***************************************************************************/
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "hdr_dpx.h"
+
+using namespace Dpx;
+
+// Bytes between rows for an image element layout (each row starts on an aligned boundary)
+static size_t FrameRowStride(const HdrDpxImageElementLayout &layout)
+{
+	const size_t datum_bytes = (layout.bit_depth == 64) ? sizeof(double) : sizeof(int32_t);
+	const size_t row_bytes = static_cast<size_t>(layout.row_size_datums) * datum_bytes;
+	return (row_bytes + FRAME_BUFFER_ALIGNMENT - 1) / FRAME_BUFFER_ALIGNMENT * FRAME_BUFFER_ALIGNMENT;
+}
+
+uint32_t HdrDpxFrameBuffer::GetHeight(void) const
+{
+	return m_height;
+}
+
+uint32_t HdrDpxFrameBuffer::GetRowSizeInDatums(void) const
+{
+	return m_row_size_datums;
+}
+
+size_t HdrDpxFrameBuffer::GetRowStride(void) const
+{
+	return m_row_stride;
+}
+
+HdrDpxFrameBuffer *HdrDpxFrameBufferPool::Allocate(size_t capacity)
+{
+	std::unique_ptr<HdrDpxFrameBuffer> buffer(new HdrDpxFrameBuffer);
+	uintptr_t start;
+
+	buffer->m_storage.reset(new uint8_t[capacity + FRAME_BUFFER_ALIGNMENT]);
+	start = reinterpret_cast<uintptr_t>(buffer->m_storage.get());
+	start = (start + FRAME_BUFFER_ALIGNMENT - 1) & ~static_cast<uintptr_t>(FRAME_BUFFER_ALIGNMENT - 1);
+	buffer->m_data = reinterpret_cast<uint8_t *>(start);
+	buffer->m_capacity = capacity;
+	m_buffers.push_back(std::move(buffer));
+	return m_buffers.back().get();
+}
+
+HdrDpxFrameBuffer *HdrDpxFrameBufferPool::Borrow(const HdrDpxImageElementLayout &layout)
+{
+	const size_t row_stride = FrameRowStride(layout);
+	const size_t size = row_stride * layout.height;
+	HdrDpxFrameBuffer *buffer = NULL;
+
+	// Use the smallest free buffer that fits, so that large buffers stay available for large image elements
+	for (auto &b : m_buffers)
+	{
+		if (!b->m_in_use && b->m_capacity >= size && (buffer == NULL || b->m_capacity < buffer->m_capacity))
+			buffer = b.get();
+	}
+	if (buffer == NULL)
+		buffer = Allocate(size);
+
+	buffer->m_row_stride = row_stride;
+	buffer->m_height = layout.height;
+	buffer->m_row_size_datums = layout.row_size_datums;
+	buffer->m_in_use = true;
+	return buffer;
+}
+
+void HdrDpxFrameBufferPool::Return(HdrDpxFrameBuffer *buffer)
+{
+	for (auto &b : m_buffers)
+	{
+		if (b.get() == buffer)
+			b->m_in_use = false;
+	}
+}
+
+void HdrDpxFrameBufferPool::Reserve(const HdrDpxImageElementLayout &layout, unsigned int count)
+{
+	const size_t size = FrameRowStride(layout) * layout.height;
+	unsigned int num_free = 0;
+
+	for (auto &b : m_buffers)
+	{
+		if (!b->m_in_use && b->m_capacity >= size)
+			num_free++;
+	}
+	for (; num_free < count; ++num_free)
+		Allocate(size);
+}
+
+void HdrDpxFrameBufferPool::Trim(void)
+{
+	std::vector<std::unique_ptr<HdrDpxFrameBuffer>> in_use;
+
+	for (auto &b : m_buffers)
+	{
+		if (b->m_in_use)
+			in_use.push_back(std::move(b));
+	}
+	m_buffers.swap(in_use);
+}
+
+unsigned int HdrDpxFrameBufferPool::GetNumBuffers(void) const
+{
+	return static_cast<unsigned int>(m_buffers.size());
+}
@@ -0,0 +1,559 @@
+/***************************************************************************
+*    Copyright (c) 2020, Broadcom Inc.
+*
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions are
+*  met:
+*
+*  1. Redistributions of source code must retain the above copyright notice,
+*     this list of conditions and the following disclaimer.
+*
+*  2. Redistributions in binary form must reproduce the above copyright
+*     notice, this list of conditions and the following disclaimer in the
+*     documentation and/or other materials provided with the distribution.
+*
+*  3. Neither the name of the copyright holder nor the names of its
+*     contributors may be used to endorse or promote products derived from
+*     this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+*  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+*  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+*  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+*  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+*  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+*  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+*  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+*  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+*  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+*  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***************************************************************************/
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "hdr_dpx.h"
+
+using namespace Dpx;
+
+// Byte offsets of header fields within the 2048-byte DPX header
+#define FILE_HDR_OFFSET(f)		(offsetof(HDRDPXFILEFORMAT, FileHeader) + offsetof(HDRDPX_GENERICFILEHEADER, f))
+#define IMAGE_HDR_OFFSET(f)		(offsetof(HDRDPXFILEFORMAT, ImageHeader) + offsetof(HDRDPX_GENERICIMAGEHEADER, f))
+#define SOURCE_HDR_OFFSET(f)	(offsetof(HDRDPXFILEFORMAT, SourceInfoHeader) + offsetof(HDRDPX_GENERICSOURCEINFOHEADER, f))
+#define FILM_HDR_OFFSET(f)		(offsetof(HDRDPXFILEFORMAT, FilmHeader) + offsetof(HDRDPX_INDUSTRYFILMINFOHEADER, f))
+#define TV_HDR_OFFSET(f)		(offsetof(HDRDPXFILEFORMAT, TvHeader) + offsetof(HDRDPX_INDUSTRYTELEVISIONINFOHEADER, f))
+#define IE_OFFSET(f)			offsetof(HDRDPX_IMAGEELEMENT, f)
+
+
+HdrDpxHeaderView::HdrDpxHeaderView(const uint8_t *data, size_t size)
+{
+	uint32_t magic = 0;
+
+	m_data = data;
+	m_size = size;
+	m_swap = false;
+	if (data != NULL && size >= sizeof(HDRDPXFILEFORMAT))
+		memcpy(&magic, data + FILE_HDR_OFFSET(Magic), 4);
+	if (magic == 0x58504453)  // XPDS
+		m_swap = true;
+	m_is_valid = (magic == 0x53445058 || magic == 0x58504453);
+}
+
+bool HdrDpxHeaderView::IsValid() const
+{
+	return m_is_valid;
+}
+
+uint32_t HdrDpxHeaderView::Read32(size_t offset) const
+{
+	uint32_t value;
+	if (!m_is_valid || offset + 4 > m_size)
+		return UNDEFINED_U32;
+	memcpy(&value, m_data + offset, 4);
+	if (m_swap)
+		ByteSwap32(&value);
+	return value;
+}
+
+uint16_t HdrDpxHeaderView::Read16(size_t offset) const
+{
+	uint16_t value;
+	if (!m_is_valid || offset + 2 > m_size)
+		return UNDEFINED_U16;
+	memcpy(&value, m_data + offset, 2);
+	if (m_swap)
+		ByteSwap16(&value);
+	return value;
+}
+
+uint8_t HdrDpxHeaderView::Read8(size_t offset) const
+{
+	if (!m_is_valid || offset >= m_size)
+		return UNDEFINED_U8;
+	return m_data[offset];
+}
+
+float HdrDpxHeaderView::ReadR32(size_t offset) const
+{
+	uint32_t u32 = Read32(offset);
+	float value;
+	memcpy(&value, &u32, 4);
+	return value;
+}
+
+std::string HdrDpxHeaderView::ReadString(size_t offset, size_t length) const
+{
+	if (!m_is_valid || offset + length > m_size)
+		return "";
+	return CopyToStringN(reinterpret_cast<const char *>(m_data + offset), static_cast<unsigned int>(length));
+}
+
+size_t HdrDpxHeaderView::IEOffset(uint8_t ie_index) const
+{
+	return IMAGE_HDR_OFFSET(ImageElement) + ie_index * sizeof(HDRDPX_IMAGEELEMENT);
+}
+
+bool HdrDpxHeaderView::IsHdr() const
+{
+	return (GetHeader(eVersion) == eDPX_2_0_HDR);
+}
+
+std::vector<uint8_t> HdrDpxHeaderView::GetIEIndexList() const
+{
+	std::vector<uint8_t> ielist;
+	if (!m_is_valid)
+		return ielist;
+	for (uint8_t ie_idx = 0; ie_idx < NUM_IMAGE_ELEMENTS; ++ie_idx)
+	{
+		if (GetHeader(ie_idx, eOffsetToData) != UNDEFINED_U32)
+			ielist.push_back(ie_idx);
+	}
+	return ielist;
+}
+
+
+std::string HdrDpxHeaderView::GetHeader(HdrDpxFieldsString field) const
+{
+	uint32_t user_size, sbm_offset, sbm_length;
+	size_t length;
+
+	switch (field)
+	{
+	case eImageFileName:
+		return ReadString(FILE_HDR_OFFSET(FileName), FILE_NAME_SIZE);
+	case eCreationDateTime:
+		return ReadString(FILE_HDR_OFFSET(TimeDate), TIMEDATE_SIZE);
+	case eCreator:
+		return ReadString(FILE_HDR_OFFSET(Creator), CREATOR_SIZE);
+	case eProjectName:
+		return ReadString(FILE_HDR_OFFSET(Project), PROJECT_SIZE);
+	case eRightToUseOrCopyright:
+		return ReadString(FILE_HDR_OFFSET(Copyright), COPYRIGHT_SIZE);
+	case eSourceImageFileName:
+		return ReadString(SOURCE_HDR_OFFSET(SourceFileName), FILE_NAME_SIZE);
+	case eSourceImageDateTime:
+		return ReadString(SOURCE_HDR_OFFSET(SourceTimeDate), TIMEDATE_SIZE);
+	case eInputDeviceName:
+		return ReadString(SOURCE_HDR_OFFSET(InputName), INPUTNAME_SIZE);
+	case eInputDeviceSN:
+		return ReadString(SOURCE_HDR_OFFSET(InputSN), INPUTSN_SIZE);
+	case eFilmMfgIdCode:
+		return ReadString(FILM_HDR_OFFSET(FilmMfgId), 2);
+	case eFilmType:
+		return ReadString(FILM_HDR_OFFSET(FilmType), 2);
+	case eOffsetInPerfs:
+		return ReadString(FILM_HDR_OFFSET(OffsetPerfs), 4);
+	case ePrefix:
+		return ReadString(FILM_HDR_OFFSET(Prefix), 6);
+	case eCount:
+		return ReadString(FILM_HDR_OFFSET(Count), 4);
+	case eFormat:
+		return ReadString(FILM_HDR_OFFSET(Format), 32);
+	case eFrameIdentification:
+		return ReadString(FILM_HDR_OFFSET(FrameId), 32);
+	case eSlateInformation:
+		return ReadString(FILM_HDR_OFFSET(SlateInfo), 100);
+	case eUserIdentification:
+		user_size = GetHeader(eUserDefinedHeaderLength);
+		if (user_size == 0 || user_size == UNDEFINED_U32)
+			return "";
+		return ReadString(sizeof(HDRDPXFILEFORMAT), 32);
+	case eUserDefinedData:
+		user_size = GetHeader(eUserDefinedHeaderLength);
+		if (user_size <= 32 || user_size == UNDEFINED_U32 || sizeof(HDRDPXFILEFORMAT) + user_size > m_size)
+			return "";
+		// Stops at the first null, like HdrDpxFile::GetHeader(eUserDefinedData)
+		return ReadString(sizeof(HDRDPXFILEFORMAT) + 32, user_size - 32);
+	case eSBMFormatDescriptor:
+		sbm_offset = GetHeader(eStandardsBasedMetadataOffset);
+		if (sbm_offset == UNDEFINED_U32)
+			return "";
+		return ReadString(sbm_offset, 128);
+	case eSBMetadata:
+		sbm_offset = GetHeader(eStandardsBasedMetadataOffset);
+		sbm_length = GetHeader(eSBMLength);
+		if (sbm_offset == UNDEFINED_U32 || sbm_length == UNDEFINED_U32)
+			return "";
+		length = static_cast<size_t>(sbm_length);
+		if (static_cast<size_t>(sbm_offset) + 132 + length > m_size)
+			return "";
+		return std::string(reinterpret_cast<const char *>(m_data + sbm_offset + 132), length);
+	}
+	return "";
+}
+
+uint32_t HdrDpxHeaderView::GetHeader(HdrDpxFieldsU32 field) const
+{
+	uint32_t sbm_offset;
+
+	switch (field)
+	{
+	case eOffsetToImageData:
+		return Read32(FILE_HDR_OFFSET(ImageOffset));
+	case eTotalImageFileSize:
+		return Read32(FILE_HDR_OFFSET(FileSize));
+	case eGenericSectionHeaderLength:
+		return Read32(FILE_HDR_OFFSET(GenericSize));
+	case eIndustrySpecificHeaderLength:
+		return Read32(FILE_HDR_OFFSET(IndustrySize));
+	case eUserDefinedHeaderLength:
+		return Read32(FILE_HDR_OFFSET(UserSize));
+	case eEncryptionKey:
+		return Read32(FILE_HDR_OFFSET(EncryptKey));
+	case eStandardsBasedMetadataOffset:
+		return Read32(FILE_HDR_OFFSET(StandardsBasedMetadataOffset));
+	case ePixelsPerLine:
+		return Read32(IMAGE_HDR_OFFSET(PixelsPerLine));
+	case eLinesPerImageElement:
+		return Read32(IMAGE_HDR_OFFSET(LinesPerElement));
+	case eXOffset:
+		return Read32(SOURCE_HDR_OFFSET(XOffset));
+	case eYOffset:
+		return Read32(SOURCE_HDR_OFFSET(YOffset));
+	case eXOriginalSize:
+		return Read32(SOURCE_HDR_OFFSET(XOriginalSize));
+	case eYOriginalSize:
+		return Read32(SOURCE_HDR_OFFSET(YOriginalSize));
+	case ePixelAspectRatioH:
+		return Read32(SOURCE_HDR_OFFSET(AspectRatio));
+	case ePixelAspectRatioV:
+		return Read32(SOURCE_HDR_OFFSET(AspectRatio) + 4);
+	case eFramePositionInSequence:
+		return Read32(FILM_HDR_OFFSET(FramePosition));
+	case eSequenceLength:
+		return Read32(FILM_HDR_OFFSET(SequenceLen));
+	case eHeldCount:
+		return Read32(FILM_HDR_OFFSET(HeldCount));
+	case eSBMLength:
+		// The length follows the 128-byte format descriptor
+		sbm_offset = Read32(FILE_HDR_OFFSET(StandardsBasedMetadataOffset));
+		if (sbm_offset == UNDEFINED_U32)
+			return 0;
+		return Read32(static_cast<size_t>(sbm_offset) + 128);
+	}
+	return 0;
+}
+
+uint16_t HdrDpxHeaderView::GetHeader(HdrDpxFieldsU16 field) const
+{
+	switch (field)
+	{
+	case eNumberOfImageElements:
+		return Read16(IMAGE_HDR_OFFSET(NumberElements));
+	case eBorderValidityXL:
+		return Read16(SOURCE_HDR_OFFSET(Border));
+	case eBorderValidityXR:
+		return Read16(SOURCE_HDR_OFFSET(Border) + 2);
+	case eBorderValidityYT:
+		return Read16(SOURCE_HDR_OFFSET(Border) + 4);
+	case eBorderValidityYB:
+		return Read16(SOURCE_HDR_OFFSET(Border) + 6);
+	}
+	return 0;
+}
+
+float HdrDpxHeaderView::GetHeader(HdrDpxFieldsR32 field) const
+{
+	switch (field)
+	{
+	case eXCenter:
+		return ReadR32(SOURCE_HDR_OFFSET(XCenter));
+	case eYCenter:
+		return ReadR32(SOURCE_HDR_OFFSET(YCenter));
+	case eXScannedSize:
+		return ReadR32(SOURCE_HDR_OFFSET(XScannedSize));
+	case eYScannedSize:
+		return ReadR32(SOURCE_HDR_OFFSET(YScannedSize));
+	case eFrameRateOfOriginal:
+		return ReadR32(FILM_HDR_OFFSET(FrameRate));
+	case eShutterAngleInDegrees:
+		return ReadR32(FILM_HDR_OFFSET(ShutterAngle));
+	case eHorizontalSamplingRate:
+		return ReadR32(TV_HDR_OFFSET(HorzSampleRate));
+	case eVerticalSamplingRate:
+		return ReadR32(TV_HDR_OFFSET(VertSampleRate));
+	case eTemporalSamplingRate:
+		return ReadR32(TV_HDR_OFFSET(FrameRate));
+	case eTimeOffsetFromSyncToFirstPixel:
+		return ReadR32(TV_HDR_OFFSET(TimeOffset));
+	case eGamma:
+		return ReadR32(TV_HDR_OFFSET(Gamma));
+	case eBlackLevelCode:
+		return ReadR32(TV_HDR_OFFSET(BlackLevel));
+	case eBlackGain:
+		return ReadR32(TV_HDR_OFFSET(BlackGain));
+	case eBreakpoint:
+		return ReadR32(TV_HDR_OFFSET(Breakpoint));
+	case eReferenceWhiteLevelCode:
+		return ReadR32(TV_HDR_OFFSET(WhiteLevel));
+	case eIntegrationTime:
+		return ReadR32(TV_HDR_OFFSET(IntegrationTimes));
+	}
+	return 0.0;
+}
+
+uint8_t HdrDpxHeaderView::GetHeader(HdrDpxFieldsU8 field) const
+{
+	switch (field)
+	{
+	case eFieldNumber:
+		return Read8(TV_HDR_OFFSET(FieldNumber));
+	case eSMPTETCDBB2Value:
+		return Read8(TV_HDR_OFFSET(SMPTETCDBB2));
+	}
+	return 0;
+}
+
+HdrDpxDittoKey HdrDpxHeaderView::GetHeader(HdrDpxFieldsDittoKey field) const
+{
+	return static_cast<HdrDpxDittoKey>(Read32(FILE_HDR_OFFSET(DittoKey)));
+}
+
+HdrDpxDatumMappingDirection HdrDpxHeaderView::GetHeader(HdrDpxFieldsDatumMappingDirection field) const
+{
+	return static_cast<HdrDpxDatumMappingDirection>(Read8(FILE_HDR_OFFSET(DatumMappingDirection)));
+}
+
+HdrDpxOrientation HdrDpxHeaderView::GetHeader(HdrDpxFieldsOrientation field) const
+{
+	return static_cast<HdrDpxOrientation>(Read16(IMAGE_HDR_OFFSET(Orientation)));
+}
+
+SMPTETimeCode HdrDpxHeaderView::GetHeader(HdrDpxFieldsTimeCode field) const
+{
+	SMPTETimeCode ret;
+	uint32_t tc = Read32(TV_HDR_OFFSET(TimeCode));
+	ret.h_tens = tc >> 28;
+	ret.h_units = (tc >> 24) & 0xf;
+	ret.m_tens = (tc >> 20) & 0xf;
+	ret.m_units = (tc >> 16) & 0xf;
+	ret.s_tens = (tc >> 12) & 0xf;
+	ret.s_units = (tc >> 8) & 0xf;
+	ret.F_tens = (tc >> 4) & 0xf;
+	ret.F_units = tc & 0xf;
+	return ret;
+}
+
+SMPTEUserBits HdrDpxHeaderView::GetHeader(HdrDpxFieldsUserBits field) const
+{
+	SMPTEUserBits ret;
+	uint32_t ub = Read32(TV_HDR_OFFSET(UserBits));
+	ret.UB8 = ub >> 28;
+	ret.UB7 = (ub >> 24) & 0xf;
+	ret.UB6 = (ub >> 20) & 0xf;
+	ret.UB5 = (ub >> 16) & 0xf;
+	ret.UB4 = (ub >> 12) & 0xf;
+	ret.UB3 = (ub >> 8) & 0xf;
+	ret.UB2 = (ub >> 4) & 0xf;
+	ret.UB1 = ub & 0xf;
+	return ret;
+}
+
+HdrDpxInterlace HdrDpxHeaderView::GetHeader(HdrDpxFieldsInterlace field) const
+{
+	return static_cast<HdrDpxInterlace>(Read8(TV_HDR_OFFSET(Interlace)));
+}
+
+HdrDpxVideoSignal HdrDpxHeaderView::GetHeader(HdrDpxFieldsVideoSignal field) const
+{
+	return static_cast<HdrDpxVideoSignal>(Read8(TV_HDR_OFFSET(VideoSignal)));
+}
+
+HdrDpxVideoIdentificationCode HdrDpxHeaderView::GetHeader(HdrDpxFieldsVideoIdentificationCode field) const
+{
+	return static_cast<HdrDpxVideoIdentificationCode>(Read8(TV_HDR_OFFSET(VideoIdentificationCode)));
+}
+
+HdrDpxSMPTETCType HdrDpxHeaderView::GetHeader(HdrDpxFieldsSMPTETCType field) const
+{
+	return static_cast<HdrDpxSMPTETCType>(Read8(TV_HDR_OFFSET(SMPTETCType)));
+}
+
+HdrDpxByteOrder HdrDpxHeaderView::GetHeader(HdrDpxFieldsByteOrder field) const
+{
+	// The magic number is "SDPX" in the first four bytes of an MSBF file
+	if (m_is_valid && m_data[0] == 'S')
+		return eMSBF;
+	if (m_is_valid)
+		return eLSBF;
+	return eNativeByteOrder;
+}
+
+HdrDpxVersion HdrDpxHeaderView::GetHeader(HdrDpxFieldsVersion field) const
+{
+	std::string version = ReadString(FILE_HDR_OFFSET(Version), 8);
+	if (version.compare("V1.0") == 0)
+		return eDPX_1_0;
+	if (version.compare("V2.0") == 0)
+		return eDPX_2_0;
+	if (version.compare("V2.0HDR") == 0)
+		return eDPX_2_0_HDR;
+	return eDPX_Unrecognized;
+}
+
+bool HdrDpxHeaderView::GetUserData(std::string &userid, std::vector<uint8_t> &userdata) const
+{
+	uint32_t user_size = GetHeader(eUserDefinedHeaderLength);
+	if (user_size < 32 || user_size == UNDEFINED_U32 || sizeof(HDRDPXFILEFORMAT) + user_size > m_size)
+		return false;
+	userid = ReadString(sizeof(HDRDPXFILEFORMAT), 32);
+	userdata.assign(m_data + sizeof(HDRDPXFILEFORMAT) + 32, m_data + sizeof(HDRDPXFILEFORMAT) + user_size);
+	return true;
+}
+
+bool HdrDpxHeaderView::GetStandardsBasedMetadata(std::string &sbm_descriptor, std::vector<uint8_t> &sbmdata) const
+{
+	uint32_t sbm_offset = GetHeader(eStandardsBasedMetadataOffset);
+	uint32_t sbm_length = GetHeader(eSBMLength);
+	if (sbm_offset == UNDEFINED_U32 || sbm_length == UNDEFINED_U32 ||
+			static_cast<size_t>(sbm_offset) + 132 + static_cast<size_t>(sbm_length) > m_size)
+		return false;
+	sbm_descriptor = ReadString(sbm_offset, 128);
+	sbmdata.assign(m_data + sbm_offset + 132, m_data + sbm_offset + 132 + sbm_length);
+	return true;
+}
+
+
+uint32_t HdrDpxHeaderView::GetHeader(uint8_t ie_index, HdrDpxIEFieldsU32 field) const
+{
+	uint32_t data_offset, file_size;
+
+	if (ie_index >= NUM_IMAGE_ELEMENTS)
+		return UNDEFINED_U32;
+	switch (field)
+	{
+	case eOffsetToData:
+		data_offset = Read32(IEOffset(ie_index) + IE_OFFSET(DataOffset));
+		file_size = Read32(FILE_HDR_OFFSET(FileSize));
+		// Same correction as HdrDpxFile::CorrectLegacyDataOffsets() for opposite-endian files written by earlier versions
+		if (m_swap && data_offset != UNDEFINED_U32 && file_size != UNDEFINED_U32 && data_offset >= file_size)
+		{
+			uint32_t reversed = data_offset;
+			ByteSwap32(&reversed);
+			if (reversed < file_size)
+				return reversed;
+		}
+		return data_offset;
+	case eEndOfLinePadding:
+		return Read32(IEOffset(ie_index) + IE_OFFSET(EndOfLinePadding));
+	case eEndOfImagePadding:
+		return Read32(IEOffset(ie_index) + IE_OFFSET(EndOfImagePadding));
+	}
+	return 0;
+}
+
+float HdrDpxHeaderView::GetHeader(uint8_t ie_index, HdrDpxIEFieldsR32 field) const
+{
+	if (ie_index >= NUM_IMAGE_ELEMENTS)
+		return 0;
+	// Code values are stored as floats for 32 and 64-bit image elements and as integers otherwise
+	bool is_float = GetHeader(ie_index, eBitDepth) >= 32;
+	switch (field)
+	{
+	case eReferenceLowDataCode:
+		if (is_float)
+			return ReadR32(IEOffset(ie_index) + IE_OFFSET(LowData));
+		else
+			return (float)Read32(IEOffset(ie_index) + IE_OFFSET(LowData));
+	case eReferenceLowQuantity:
+		return ReadR32(IEOffset(ie_index) + IE_OFFSET(LowQuantity));
+	case eReferenceHighDataCode:
+		if (is_float)
+			return ReadR32(IEOffset(ie_index) + IE_OFFSET(HighData));
+		else
+			return (float)Read32(IEOffset(ie_index) + IE_OFFSET(HighData));
+	case eReferenceHighQuantity:
+		return ReadR32(IEOffset(ie_index) + IE_OFFSET(HighQuantity));
+	}
+	return 0;
+}
+
+std::string HdrDpxHeaderView::GetHeader(uint8_t ie_index, HdrDpxIEFieldsString field) const
+{
+	if (ie_index >= NUM_IMAGE_ELEMENTS)
+		return "";
+	switch (field)
+	{
+	case eDescriptionOfImageElement:
+		return ReadString(IEOffset(ie_index) + IE_OFFSET(Description), DESCRIPTION_SIZE);
+	}
+	return "";
+}
+
+HdrDpxDataSign HdrDpxHeaderView::GetHeader(uint8_t ie_index, HdrDpxFieldsDataSign field) const
+{
+	if (ie_index >= NUM_IMAGE_ELEMENTS)
+		return static_cast<HdrDpxDataSign>(UNDEFINED_U32);
+	return static_cast<HdrDpxDataSign>(Read32(IEOffset(ie_index) + IE_OFFSET(DataSign)));
+}
+
+HdrDpxDescriptor HdrDpxHeaderView::GetHeader(uint8_t ie_index, HdrDpxFieldsDescriptor field) const
+{
+	if (ie_index >= NUM_IMAGE_ELEMENTS)
+		return static_cast<HdrDpxDescriptor>(UNDEFINED_U8);
+	return static_cast<HdrDpxDescriptor>(Read8(IEOffset(ie_index) + IE_OFFSET(Descriptor)));
+}
+
+HdrDpxTransfer HdrDpxHeaderView::GetHeader(uint8_t ie_index, HdrDpxFieldsTransfer field) const
+{
+	if (ie_index >= NUM_IMAGE_ELEMENTS)
+		return static_cast<HdrDpxTransfer>(UNDEFINED_U8);
+	return static_cast<HdrDpxTransfer>(Read8(IEOffset(ie_index) + IE_OFFSET(Transfer)));
+}
+
+HdrDpxColorimetric HdrDpxHeaderView::GetHeader(uint8_t ie_index, HdrDpxFieldsColorimetric field) const
+{
+	if (ie_index >= NUM_IMAGE_ELEMENTS)
+		return static_cast<HdrDpxColorimetric>(UNDEFINED_U8);
+	return static_cast<HdrDpxColorimetric>(Read8(IEOffset(ie_index) + IE_OFFSET(Colorimetric)));
+}
+
+HdrDpxBitDepth HdrDpxHeaderView::GetHeader(uint8_t ie_index, HdrDpxFieldsBitDepth field) const
+{
+	if (ie_index >= NUM_IMAGE_ELEMENTS)
+		return static_cast<HdrDpxBitDepth>(UNDEFINED_U8);
+	return static_cast<HdrDpxBitDepth>(Read8(IEOffset(ie_index) + IE_OFFSET(BitSize)));
+}
+
+HdrDpxPacking HdrDpxHeaderView::GetHeader(uint8_t ie_index, HdrDpxFieldsPacking field) const
+{
+	if (ie_index >= NUM_IMAGE_ELEMENTS)
+		return static_cast<HdrDpxPacking>(UNDEFINED_U16);
+	return static_cast<HdrDpxPacking>(Read16(IEOffset(ie_index) + IE_OFFSET(Packing)));
+}
+
+HdrDpxEncoding HdrDpxHeaderView::GetHeader(uint8_t ie_index, HdrDpxFieldsEncoding field) const
+{
+	if (ie_index >= NUM_IMAGE_ELEMENTS)
+		return static_cast<HdrDpxEncoding>(UNDEFINED_U16);
+	return static_cast<HdrDpxEncoding>(Read16(IEOffset(ie_index) + IE_OFFSET(Encoding)));
+}
+
+HdrDpxColorDifferenceSiting HdrDpxHeaderView::GetHeader(uint8_t ie_index, HdrDpxFieldsColorDifferenceSiting field) const
+{
+	if (ie_index >= NUM_IMAGE_ELEMENTS)
+		return static_cast<HdrDpxColorDifferenceSiting>(0);
+	return static_cast<HdrDpxColorDifferenceSiting>(Read32(IMAGE_HDR_OFFSET(ChromaSubsampling)) >> (ie_index * 4) & 0xf);
+}
@@ -31,9 +31,12 @@
 ***************************************************************************/
 #include <string>
 #include <iostream>
+#include <algorithm>
 #include <fstream>
 #include <memory>
 #include <cmath>
+#include <cstring>
+#include <thread>
 #include "hdr_dpx.h"
 #include "fifo.h"
 
@@ -63,285 +66,21 @@ using namespace Dpx;
 
 std::vector<DatumLabel> Dpx::DescriptorToDatumList(uint8_t desc)
 {
-	std::vector<DatumLabel> dl;
-	dl.clear();
-	switch (desc)
-	{
-	case eDescUser:
-	case eDescUndefined:
-		dl.push_back(DATUM_UNSPEC);
-		break;
-	case eDescR:
-		dl.push_back(DATUM_R);
-		break;
-	case eDescG:
-		dl.push_back(DATUM_G);
-		break;
-	case eDescB:
-		dl.push_back(DATUM_B);
-		break;
-	case eDescA:
-		dl.push_back(DATUM_A);
-		break;
-	case eDescY:
-		dl.push_back(DATUM_Y);
-		break;
-	case eDescCbCr:
-		dl.push_back(DATUM_CB);
-		dl.push_back(DATUM_CR);
-		break;
-	case eDescZ:
-		dl.push_back(DATUM_Z);
-		break;
-	case eDescComposite:
-		dl.push_back(DATUM_COMPOSITE);
-		break;
-	case eDescCb:
-		dl.push_back(DATUM_CB);
-		break;
-	case eDescCr:
-		dl.push_back(DATUM_CR);
-		break;
-	case eDescRGB_268_1:
-		dl.push_back(DATUM_R);
-		dl.push_back(DATUM_G);
-		dl.push_back(DATUM_B);
-		break;
-	case eDescRGBA_268_1:
-		dl.push_back(DATUM_R);
-		dl.push_back(DATUM_G);
-		dl.push_back(DATUM_B);
-		dl.push_back(DATUM_A);
-		break;
-	case eDescABGR_268_1:
-		dl.push_back(DATUM_A);
-		dl.push_back(DATUM_B);
-		dl.push_back(DATUM_G);
-		dl.push_back(DATUM_R);
-		break;
-	case eDescBGR:
-		dl.push_back(DATUM_B);
-		dl.push_back(DATUM_G);
-		dl.push_back(DATUM_R);
-		break;
-	case eDescBGRA:
-		dl.push_back(DATUM_B);
-		dl.push_back(DATUM_G);
-		dl.push_back(DATUM_R);
-		dl.push_back(DATUM_A);
-		break;
-	case eDescARGB:
-		dl.push_back(DATUM_A);
-		dl.push_back(DATUM_R);
-		dl.push_back(DATUM_G);
-		dl.push_back(DATUM_B);
-		break;
-	case eDescRGB:
-		dl.push_back(DATUM_R);
-		dl.push_back(DATUM_G);
-		dl.push_back(DATUM_B);
-		break;
-	case eDescRGBA:
-		dl.push_back(DATUM_R);
-		dl.push_back(DATUM_G);
-		dl.push_back(DATUM_B);
-		dl.push_back(DATUM_A);
-		break;
-	case eDescABGR:
-		dl.push_back(DATUM_A);
-		dl.push_back(DATUM_B);
-		dl.push_back(DATUM_G);
-		dl.push_back(DATUM_R);
-		break;
-	case eDescCbYCrY:
-		dl.push_back(DATUM_CB);
-		dl.push_back(DATUM_Y);
-		dl.push_back(DATUM_CR);
-		dl.push_back(DATUM_Y2);
-		break;
-	case eDescCbYACrYA:
-		dl.push_back(DATUM_CB);
-		dl.push_back(DATUM_Y);
-		dl.push_back(DATUM_A);
-		dl.push_back(DATUM_CR);
-		dl.push_back(DATUM_Y2);
-		dl.push_back(DATUM_A2);
-		break;
-	case eDescCbYCr:
-		dl.push_back(DATUM_CB);
-		dl.push_back(DATUM_Y);
-		dl.push_back(DATUM_CR);
-		break;
-	case eDescCbYCrA:
-		dl.push_back(DATUM_CB);
-		dl.push_back(DATUM_Y);
-		dl.push_back(DATUM_CR);
-		dl.push_back(DATUM_A);
-		break;
-	case eDescCYY:
-		dl.push_back(DATUM_C);
-		dl.push_back(DATUM_Y);
-		dl.push_back(DATUM_Y2);
-		break;
-	case eDescCYAYA:
-		dl.push_back(DATUM_C);
-		dl.push_back(DATUM_Y);
-		dl.push_back(DATUM_A);
-		dl.push_back(DATUM_Y2);
-		dl.push_back(DATUM_A2);
-		break;
-	case eDescGeneric2:
-		dl.push_back(DATUM_UNSPEC);
-		dl.push_back(DATUM_UNSPEC2);
-		break;
-	case eDescGeneric3:
-		dl.push_back(DATUM_UNSPEC);
-		dl.push_back(DATUM_UNSPEC2);
-		dl.push_back(DATUM_UNSPEC3);
-		break;
-	case eDescGeneric4:
-		dl.push_back(DATUM_UNSPEC);
-		dl.push_back(DATUM_UNSPEC2);
-		dl.push_back(DATUM_UNSPEC3);
-		dl.push_back(DATUM_UNSPEC4);
-		break;
-	case eDescGeneric5:
-		dl.push_back(DATUM_UNSPEC);
-		dl.push_back(DATUM_UNSPEC2);
-		dl.push_back(DATUM_UNSPEC3);
-		dl.push_back(DATUM_UNSPEC4);
-		dl.push_back(DATUM_UNSPEC5);
-		break;
-	case eDescGeneric6:
-		dl.push_back(DATUM_UNSPEC);
-		dl.push_back(DATUM_UNSPEC2);
-		dl.push_back(DATUM_UNSPEC3);
-		dl.push_back(DATUM_UNSPEC4);
-		dl.push_back(DATUM_UNSPEC5);
-		dl.push_back(DATUM_UNSPEC6);
-		break;
-	case eDescGeneric7:
-		dl.push_back(DATUM_UNSPEC);
-		dl.push_back(DATUM_UNSPEC2);
-		dl.push_back(DATUM_UNSPEC3);
-		dl.push_back(DATUM_UNSPEC4);
-		dl.push_back(DATUM_UNSPEC5);
-		dl.push_back(DATUM_UNSPEC6);
-		dl.push_back(DATUM_UNSPEC7);
-		break;
-	case eDescGeneric8:
-		dl.push_back(DATUM_UNSPEC);
-		dl.push_back(DATUM_UNSPEC2);
-		dl.push_back(DATUM_UNSPEC3);
-		dl.push_back(DATUM_UNSPEC4);
-		dl.push_back(DATUM_UNSPEC5);
-		dl.push_back(DATUM_UNSPEC6);
-		dl.push_back(DATUM_UNSPEC7);
-		dl.push_back(DATUM_UNSPEC8);
-		break;
-	}
-	return dl;
+	const DescriptorDatums &dd = GetDescriptorDatums(desc);
+	return std::vector<DatumLabel>(dd.labels, dd.labels + dd.num_components);
 }
 
-uint8_t Dpx::DatumListToDescriptor(std::vector<DatumLabel> dl)
+uint8_t Dpx::DatumListToDescriptor(const std::vector<DatumLabel> &dl)
 {
 	if (dl.size() == 0)
 		return 255;
-	if (dl.size() == 1)
-	{
-		if (dl[0] == DATUM_UNSPEC)
-			return eDescUser;
-		if (dl[0] == DATUM_R)
-			return eDescR;
-		if (dl[0] == DATUM_G)
-			return eDescG;
-		if (dl[0] == DATUM_B)
-			return eDescB;
-		if (dl[0] == DATUM_A)
-			return eDescA;
-		if (dl[0] == DATUM_Y)
-			return eDescY;
-		if (dl[0] == DATUM_Z)
-			return eDescZ;
-		if (dl[0] == DATUM_COMPOSITE)
-			return eDescComposite;
-		if (dl[0] == DATUM_CB)
-			return eDescCb;
-		if (dl[0] == DATUM_CR)
-			return eDescCr;
-		return 255;
-	}
-	if (dl.size() == 2)
+	for (const DescriptorDatums &dd : DESCRIPTOR_DATUMS)
 	{
-		if (dl[0] == DATUM_CB && dl[1] == DATUM_CR)
-			return eDescCbCr;
-		if (dl[0] == DATUM_UNSPEC && dl[1] == DATUM_UNSPEC2)
-			return eDescGeneric2;
-		return 255;
-	}
-	if (dl.size() == 3)
-	{
-		if (dl[0] == DATUM_B && dl[1] == DATUM_G && dl[2] == DATUM_R)
-			return eDescBGR;
-		if (dl[0] == DATUM_R && dl[1] == DATUM_G && dl[2] == DATUM_B)
-			return eDescRGB;
-		if (dl[0] == DATUM_CB && dl[1] == DATUM_Y && dl[2] == DATUM_CR)
-			return eDescCbYCr;
-		if (dl[0] == DATUM_C && dl[1] == DATUM_Y && dl[2] == DATUM_Y2)
-			return eDescCYY;
-		if (dl[0] == DATUM_UNSPEC && dl[1] == DATUM_UNSPEC2 && dl[2] == DATUM_UNSPEC3)
-			return eDescGeneric3;
-		return 255;
-	}
-	if (dl.size() == 4)
-	{
-		if (dl[0] == DATUM_B && dl[1] == DATUM_G && dl[2] == DATUM_R && dl[3] == DATUM_A)
-			return eDescBGRA;
-		if (dl[0] == DATUM_A && dl[1] == DATUM_R && dl[2] == DATUM_G && dl[3] == DATUM_B)
-			return eDescARGB;
-		if (dl[0] == DATUM_R && dl[1] == DATUM_G && dl[2] == DATUM_B && dl[3] == DATUM_A)
-			return eDescRGBA;
-		if (dl[0] == DATUM_A && dl[1] == DATUM_B && dl[2] == DATUM_G && dl[3] == DATUM_R)
-			return eDescARGB;
-		if (dl[0] == DATUM_CB && dl[1] == DATUM_Y && dl[2] == DATUM_CR && dl[3] == DATUM_Y2)
-			return eDescCbYCrY;
-		if (dl[0] == DATUM_CB && dl[1] == DATUM_Y && dl[2] == DATUM_CR && dl[3] == DATUM_A)
-			return eDescCbYCrA;
-		if (dl[0] == DATUM_UNSPEC && dl[1] == DATUM_UNSPEC2 && dl[2] == DATUM_UNSPEC3 && dl[3] == DATUM_UNSPEC4)
-			return eDescGeneric4;
-		return 255;
-	}
-	if (dl.size() == 5)
-	{
-		if (dl[0] == DATUM_C && dl[1] == DATUM_Y && dl[2] == DATUM_A && dl[3] == DATUM_Y2 && dl[4] == DATUM_A2)
-			return eDescCYAYA;
-		if (dl[0] == DATUM_UNSPEC && dl[1] == DATUM_UNSPEC2 && dl[2] == DATUM_UNSPEC3 && dl[3] == DATUM_UNSPEC4 &&
-			dl[4] == DATUM_UNSPEC5)
-			return eDescGeneric5;
-		return 255;
-	}
-	if (dl.size() == 6)
-	{
-		if (dl[0] == DATUM_CB && dl[1] == DATUM_Y && dl[2] == DATUM_A && dl[3] == DATUM_CR && dl[4] == DATUM_Y2 && dl[5] == DATUM_A2)
-			return eDescCbYACrYA;
-		if (dl[0] == DATUM_UNSPEC && dl[1] == DATUM_UNSPEC2 && dl[2] == DATUM_UNSPEC3 && dl[3] == DATUM_UNSPEC4 &&
-			dl[4] == DATUM_UNSPEC5 && dl[5] == DATUM_UNSPEC6)
-			return eDescGeneric6;
-		return 255;
-	}
-	if (dl.size() == 7)
-	{
-		if (dl[0] == DATUM_UNSPEC && dl[1] == DATUM_UNSPEC2 && dl[2] == DATUM_UNSPEC3 && dl[3] == DATUM_UNSPEC4 &&
-			dl[4] == DATUM_UNSPEC5 && dl[5] == DATUM_UNSPEC6 && dl[6] == DATUM_UNSPEC7)
-			return eDescGeneric7;
-		return 255;
-	}
-	if (dl.size() == 8)
-	{
-		if (dl[0] == DATUM_UNSPEC && dl[1] == DATUM_UNSPEC2 && dl[2] == DATUM_UNSPEC3 && dl[3] == DATUM_UNSPEC4 &&
-			dl[4] == DATUM_UNSPEC5 && dl[5] == DATUM_UNSPEC6 && dl[6] == DATUM_UNSPEC7 && dl[7] == DATUM_UNSPEC8)
-			return eDescGeneric8;
-		return 255;
+		// The deprecated RP 268-1 codes have the same datums as newer codes, which are preferred
+		if (dd.descriptor == eDescRGB_268_1 || dd.descriptor == eDescRGBA_268_1 || dd.descriptor == eDescABGR_268_1)
+			continue;
+		if (dd.num_components == dl.size() && std::equal(dl.begin(), dl.end(), dd.labels))
+			return dd.descriptor;
 	}
 	return 255;
 }
@@ -395,18 +134,18 @@ std::string HdrDpxImageElement::DatumLabelToName(Dpx::DatumLabel dl) const
 	}
 }
 
-HdrDpxImageElement::HdrDpxImageElement() : m_fifo(16)
+HdrDpxImageElement::HdrDpxImageElement()
 {
 	m_isinitialized = false;
 }
 
-HdrDpxImageElement::HdrDpxImageElement(uint8_t ie_index, std::fstream *fstream_ptr, HDRDPXFILEFORMAT *dpxf_ptr, FileMap *file_map_ptr) : m_fifo(16)
+HdrDpxImageElement::HdrDpxImageElement(uint8_t ie_index, std::iostream *fstream_ptr, HDRDPXFILEFORMAT *dpxf_ptr, FileMap *file_map_ptr)
 {
 	m_is_header_locked = false;
 	Initialize(ie_index, fstream_ptr, dpxf_ptr, file_map_ptr);
 }
 
-void HdrDpxImageElement::Initialize(uint8_t ie_index, std::fstream *fstream_ptr, HDRDPXFILEFORMAT *dpxf_ptr, FileMap *file_map_ptr)
+void HdrDpxImageElement::Initialize(uint8_t ie_index, std::iostream *fstream_ptr, HDRDPXFILEFORMAT *dpxf_ptr, FileMap *file_map_ptr)
 {
 	m_ie_index = ie_index;
 	m_isinitialized = true;
@@ -417,6 +156,7 @@ void HdrDpxImageElement::Initialize(uint8_t ie_index, std::fstream *fstream_ptr,
 	m_is_open_for_read = false;
 	m_is_open_for_write = false;
 	m_is_header_locked = false;
+	m_is_layout_locked = false;
 	m_err.Clear();
 	m_warnings.clear();
 }
@@ -432,28 +172,116 @@ void HdrDpxImageElement::Deinitialize()
 	m_isinitialized = false;
 }
 
+// Number of 32-bit image data words needed to hold one row of num_datums datums
+static uint32_t IdwPerRow(uint32_t num_datums, uint8_t bit_size, uint16_t packing)
+{
+	if (bit_size == 64)
+		return 2 * num_datums;
+	else if (bit_size == 32)
+		return num_datums;
+	else if (bit_size == 16)
+		return (num_datums + 1) / 2;
+	else if (packing == 0 || bit_size == 8)
+		return static_cast<uint32_t>((static_cast<uint64_t>(num_datums) * bit_size + 31) / 32);
+	else if (bit_size == 10)   // 3 datums per IDW
+		return (num_datums + 2) / 3;
+	else  // 12 bits, 2 datums per IDW
+		return (num_datums + 1) / 2;
+}
 
-void HdrDpxImageElement::ComputeWidthAndHeight()
+void HdrDpxImageElement::ComputeLayout()
 {
-	m_is_h_subsampled = m_is_v_subsampled = false;
+	m_layout.is_h_subsampled = m_layout.is_v_subsampled = false;
 	if (m_dpx_ie_ptr->Descriptor == eDescCb || m_dpx_ie_ptr->Descriptor == eDescCr)
-		m_is_h_subsampled = m_is_v_subsampled = true;
+		m_layout.is_h_subsampled = m_layout.is_v_subsampled = true;
 	else if (m_dpx_ie_ptr->Descriptor == eDescCbCr || m_dpx_ie_ptr->Descriptor == eDescCbYCrY ||
 		m_dpx_ie_ptr->Descriptor == eDescCbYACrYA || m_dpx_ie_ptr->Descriptor == eDescCYY ||
 		m_dpx_ie_ptr->Descriptor == eDescCYAYA)
-		m_is_h_subsampled = true;
-	m_width = m_dpx_hdr_ptr->ImageHeader.PixelsPerLine / (m_is_h_subsampled ? 2 : 1);
-	m_height = m_dpx_hdr_ptr->ImageHeader.LinesPerElement / (m_is_v_subsampled ? 2 : 1);
+		m_layout.is_h_subsampled = true;
+	m_layout.descriptor = m_dpx_ie_ptr->Descriptor;
+	m_layout.width = m_dpx_hdr_ptr->ImageHeader.PixelsPerLine / (m_layout.is_h_subsampled ? 2 : 1);
+	m_layout.height = m_dpx_hdr_ptr->ImageHeader.LinesPerElement / (m_layout.is_v_subsampled ? 2 : 1);
+	m_layout.datum_labels = DescriptorToDatumList(m_dpx_ie_ptr->Descriptor);
+	m_layout.num_components = static_cast<uint8_t>(m_layout.datum_labels.size());
+	m_layout.bit_depth = m_dpx_ie_ptr->BitSize;
+	m_layout.packing = m_dpx_ie_ptr->Packing;
+	m_layout.is_rle = (m_dpx_ie_ptr->Encoding == 1);
+	m_layout.direction_r2l = (m_dpx_hdr_ptr->FileHeader.DatumMappingDirection == 0);
+	m_layout.row_size_datums = m_layout.width * m_layout.num_components;
+	m_layout.row_size_bytes = 4 * IdwPerRow(m_layout.row_size_datums, m_layout.bit_depth, m_layout.packing);
+	m_layout.row_stride_bytes = m_layout.row_size_bytes + (m_dpx_ie_ptr->EndOfLinePadding == UNDEFINED_U32 ? 0 : (m_dpx_ie_ptr->EndOfLinePadding / 4) * 4);
+	m_layout.end_of_image_padding = (m_dpx_ie_ptr->EndOfImagePadding == UNDEFINED_U32) ? 0 : m_dpx_ie_ptr->EndOfImagePadding;
+	m_has_layout = true;
+}
+
+bool HdrDpxImageElement::LayoutMatchesHeader(void) const
+{
+	const uint32_t eol_padding = (m_dpx_ie_ptr->EndOfLinePadding == UNDEFINED_U32) ? 0 : (m_dpx_ie_ptr->EndOfLinePadding / 4) * 4;
+	const uint32_t eoi_padding = (m_dpx_ie_ptr->EndOfImagePadding == UNDEFINED_U32) ? 0 : m_dpx_ie_ptr->EndOfImagePadding;
+
+	// The descriptor determines the subsampling and datum labels, so the remaining fields are compared directly
+	return m_dpx_ie_ptr->Descriptor == m_layout.descriptor &&
+		m_dpx_ie_ptr->BitSize == m_layout.bit_depth &&
+		m_dpx_ie_ptr->Packing == m_layout.packing &&
+		(m_dpx_ie_ptr->Encoding == 1) == m_layout.is_rle &&
+		(m_dpx_hdr_ptr->FileHeader.DatumMappingDirection == 0) == m_layout.direction_r2l &&
+		m_dpx_hdr_ptr->ImageHeader.PixelsPerLine / (m_layout.is_h_subsampled ? 2 : 1) == m_layout.width &&
+		m_dpx_hdr_ptr->ImageHeader.LinesPerElement / (m_layout.is_v_subsampled ? 2 : 1) == m_layout.height &&
+		m_layout.row_size_bytes + eol_padding == m_layout.row_stride_bytes &&
+		eoi_padding == m_layout.end_of_image_padding;
+}
+
+void HdrDpxImageElement::Rebind(std::iostream *fstream_ptr, HDRDPXFILEFORMAT *dpxf_ptr, FileMap *file_map_ptr)
+{
+	if (m_ie_index >= NUM_IMAGE_ELEMENTS)
+		return;    // never initialized, so there is nothing to point at
+	m_dpx_ie_ptr = &(dpxf_ptr->ImageHeader.ImageElement[m_ie_index]);
+	m_dpx_hdr_ptr = dpxf_ptr;
+	m_filestream_ptr = fstream_ptr;
+	m_file_map_ptr = file_map_ptr;
+}
+
+const HdrDpxImageElementLayout &HdrDpxImageElement::GetLayout(void) const
+{
+	return m_layout;
 }
 
 void HdrDpxImageElement::OpenForReading(bool bswap)
 {
-	ComputeWidthAndHeight();
+	ComputeLayout();
+	m_byte_swap = bswap;
+	m_rle_row_offsets.clear();
+	if (m_dpx_ie_ptr->Encoding == 1 && m_layout.height > 0)
+	{
+		// Offsets of later rows are learned as rows are decoded (or come from a row index)
+		m_rle_row_offsets.assign(m_layout.height, UNDEFINED_U32);
+		m_rle_row_offsets[0] = m_dpx_ie_ptr->DataOffset;
+	}
+	m_is_open_for_read = true;
+	m_is_open_for_write = false;
+	m_is_header_locked = true;
+}
+
+bool HdrDpxImageElement::ReopenForReading(bool bswap)
+{
+	if (!m_has_layout || !LayoutMatchesHeader())
+		return false;
+	m_isinitialized = true;
+	m_err.Clear();
+	m_warnings.clear();
 	m_byte_swap = bswap;
-	m_direction_r2l = (m_dpx_hdr_ptr->FileHeader.DatumMappingDirection == 0);
+	if (m_layout.is_rle && m_layout.height > 0)
+	{
+		// Reuses the row offset storage from the previous file
+		m_rle_row_offsets.assign(m_layout.height, UNDEFINED_U32);
+		m_rle_row_offsets[0] = m_dpx_ie_ptr->DataOffset;
+	}
+	else
+		m_rle_row_offsets.clear();
 	m_is_open_for_read = true;
 	m_is_open_for_write = false;
 	m_is_header_locked = true;
+	return true;
 }
 
 void HdrDpxImageElement::OpenForWriting(bool bswap)
@@ -468,10 +296,27 @@ void HdrDpxImageElement::OpenForWriting(bool bswap)
 		LOG_ERROR(eFileWriteError, eFatal, "Cannot write image element " + std::to_string(m_ie_index + 1) + " without bit depth field");
 		return;
 	}
-	ComputeWidthAndHeight();
+	if (!m_has_layout || !LayoutMatchesHeader())
+		ComputeLayout();
 
 	m_byte_swap = bswap;
-	m_direction_r2l = (m_dpx_hdr_ptr->FileHeader.DatumMappingDirection == 0);
+	m_rle_row_offsets.clear();
+	m_rle_row_buffers.clear();
+	if (m_dpx_ie_ptr->Encoding == 1)
+	{
+		m_rle_row_offsets.assign(m_layout.height, UNDEFINED_U32);
+		if (m_buffer_rle_rows)
+			m_rle_row_buffers.resize(m_layout.height);
+	}
+	// Size the row encoder for the largest row up front so that writing rows does not allocate.
+	// An RLE row has at most one flag datum per pixel, so it is never more than twice the size of an uncompressed row.
+	m_row_encoder.words.reserve((m_layout.is_rle ? 2 : 1) * (m_layout.row_size_bytes / 4) + 1);
+	if (m_layout.is_rle && m_optimal_rle)
+	{
+		m_row_encoder.run_cost.reserve(m_layout.width + 1);
+		m_row_encoder.run_choice.reserve(m_layout.width + 1);
+		m_row_encoder.run_window.reserve(m_layout.width + 1);
+	}
 	m_is_open_for_write = true;
 	m_is_open_for_read = false;
 	m_is_header_locked = true;
@@ -488,46 +333,45 @@ void HdrDpxImageElement::UnlockHeader(void)
 	m_is_header_locked = false;
 }
 
+bool HdrDpxImageElement::RefuseLayoutChange(void)
+{
+	if (!m_is_layout_locked)
+		return false;
+	LOG_ERROR(eHeaderLocked, eWarning, "Fields that set the layout of image element " + std::to_string(m_ie_index + 1) + " cannot be changed when updating a header in place");
+	return true;
+}
+
 std::vector<DatumLabel> HdrDpxImageElement::GetDatumLabels(void) const
 {
+	if (m_is_open_for_read || m_is_open_for_write)
+		return m_layout.datum_labels;
 	return DescriptorToDatumList(m_dpx_ie_ptr->Descriptor);
 }
 
 uint8_t HdrDpxImageElement::GetNumberOfComponents(void) const
 {
-	return static_cast<int>(GetDatumLabels().size());
+	if (m_is_open_for_read || m_is_open_for_write)
+		return m_layout.num_components;
+	return DescriptorNumComponents(m_dpx_ie_ptr->Descriptor);
 }
 
 uint8_t HdrDpxImageElement::GetDatumLabelIndex(DatumLabel dl) const
 {
 	uint8_t i;
-	std::vector<DatumLabel> dl_list = GetDatumLabels();
-	for (i = 0; i < GetNumberOfComponents(); ++i)
-		if (dl == dl_list[i])
+	const DescriptorDatums &dd = GetDescriptorDatums(m_dpx_ie_ptr->Descriptor);
+	for (i = 0; i < dd.num_components; ++i)
+		if (dl == dd.labels[i])
 			return i;
 	return 0xff;
 }
 
 uint32_t HdrDpxImageElement::GetRowSizeInBytes(bool include_padding) const
 {
-	uint8_t num_c = GetNumberOfComponents();
 	uint32_t idw_per_line;
 
-	if (m_dpx_ie_ptr->BitSize == 64)
-		idw_per_line = static_cast<uint32_t>(2 * num_c * m_width);
-	else if (m_dpx_ie_ptr->BitSize == 32)
-		idw_per_line = static_cast<uint32_t>(num_c * m_width);
-	else if (m_dpx_ie_ptr->BitSize == 16)
-		idw_per_line = static_cast<uint32_t>(std::ceil(num_c * m_width / 2.0));
-	else if (m_dpx_ie_ptr->Packing == 0 || m_dpx_ie_ptr->BitSize == 8)
-		idw_per_line = static_cast<uint32_t>(std::ceil(num_c * m_width * m_dpx_ie_ptr->BitSize / 8.0 / 4.0));
-	else
-	{
-		if (m_dpx_ie_ptr->BitSize == 10)   // 3 datums per IDW
-			idw_per_line = static_cast<uint32_t>(std::ceil(num_c * m_width / 3.0));
-		else  // 12 bits, 2 datums per IDW
-			idw_per_line = static_cast<uint32_t>(std::ceil(num_c * m_width / 2.0));
-	}
+	if (m_is_open_for_read || m_is_open_for_write)
+		return include_padding ? m_layout.row_stride_bytes : m_layout.row_size_bytes;
+	idw_per_line = IdwPerRow(m_layout.width * GetNumberOfComponents(), m_dpx_ie_ptr->BitSize, m_dpx_ie_ptr->Packing);
 	if(include_padding)
 		idw_per_line += m_dpx_ie_ptr->EndOfLinePadding / 4;
 	return idw_per_line * 4;
@@ -535,6 +379,8 @@ uint32_t HdrDpxImageElement::GetRowSizeInBytes(bool include_padding) const
 
 uint32_t HdrDpxImageElement::GetRowSizeInDatums() const
 {
+	if (m_is_open_for_read || m_is_open_for_write)
+		return m_layout.row_size_datums;
 	return GetWidth() * GetNumberOfComponents();
 }
 
@@ -623,7 +469,7 @@ void HdrDpxImageElement::ReadRow(uint32_t row)
 	int num_components;
 	uint32_t xpos;
 	uint32_t image_data_word;
-	Fifo fifo(16);
+	Fifo &fifo = m_read_fifo;
 	int32_t int_datum = 0;
 	uint32_t row_wr_idx = 0;
 	uint32_t expected_zero;
@@ -638,34 +484,29 @@ void HdrDpxImageElement::ReadRow(uint32_t row)
 	int rle_state = 0;   // 0 = flag, 1-n = component value
 	int32_t run_length = 0;
 	int rle_count = 0;
-	int32_t rle_pixel[8];
 	bool rle_is_same;
 	const bool is_signed = (m_dpx_ie_ptr->DataSign == 1);
 	const uint8_t bpc = m_dpx_ie_ptr->BitSize;
 
 	if (m_dpx_ie_ptr->Encoding == 1)  // RLE
 	{
-		if (row == 0)
-		{
-			m_filestream_ptr->seekg(m_dpx_ie_ptr->DataOffset);
-		}
-		else if (row != m_previous_row + 1)
+		if (row >= m_rle_row_offsets.size() || m_rle_row_offsets[row] == UNDEFINED_U32)
 		{
-			LOG_ERROR(eBadParameter, eFatal, "When RLE is enabled, rows must be read in sequential order");
+			LOG_ERROR(eBadParameter, eFatal, "When RLE is enabled, rows must be read in sequential order unless the file contains an RLE row index");
 			return;
 		}
-		else
-			m_filestream_ptr->seekg(m_previous_file_offset);
+		m_filestream_ptr->seekg(m_rle_row_offsets[row]);
 		m_previous_row = row;
 	}
 	else
 		m_filestream_ptr->seekg(GetOffsetForRow(row));
 
-	num_components = GetNumberOfComponents();
+	fifo.Clear();
+	num_components = m_layout.num_components;
 
 	xpos = 0;
 	component = 0;
-	while (xpos < m_width && component < num_components)
+	while (xpos < m_layout.width && component < num_components)
 	{
 		while (fifo.m_fullness <= 32)
 		{
@@ -679,13 +520,13 @@ void HdrDpxImageElement::ReadRow(uint32_t row)
 		case 1:
 		case 8:
 		case 16:
-			int_datum = fifo.GetDatum(bpc, is_signed, m_direction_r2l);
+			int_datum = fifo.GetDatum(bpc, is_signed, m_layout.direction_r2l);
 			break;
 		case 10:
 		case 12:
 			if (m_dpx_ie_ptr->Packing == 1) // Method A
 			{
-				if (m_direction_r2l)
+				if (m_layout.direction_r2l)
 				{
 					if (fifo.m_fullness == 48 || fifo.m_fullness == 64)   // start with padding bits
 					{
@@ -710,8 +551,8 @@ void HdrDpxImageElement::ReadRow(uint32_t row)
 					}
 				}
 
-				int_datum = fifo.GetDatum(bpc, is_signed, m_direction_r2l);
-				if (!m_direction_r2l)
+				int_datum = fifo.GetDatum(bpc, is_signed, m_layout.direction_r2l);
+				if (!m_layout.direction_r2l)
 				{
 					if (fifo.m_fullness == 64 - 30)
 					{
@@ -735,7 +576,7 @@ void HdrDpxImageElement::ReadRow(uint32_t row)
 			}
 			else if (m_dpx_ie_ptr->Packing == 2) // Method B
 			{
-				if (!m_direction_r2l)
+				if (!m_layout.direction_r2l)
 				{
 					if (fifo.m_fullness == 64 - 0 || fifo.m_fullness == 64 - 16)
 					{
@@ -759,8 +600,8 @@ void HdrDpxImageElement::ReadRow(uint32_t row)
 						}
 					}
 				}
-				int_datum = fifo.GetDatum(bpc, is_signed, m_direction_r2l);
-				if (m_direction_r2l)
+				int_datum = fifo.GetDatum(bpc, is_signed, m_layout.direction_r2l);
+				if (m_layout.direction_r2l)
 				{
 					if (fifo.m_fullness == 64 - 30)
 					{
@@ -784,7 +625,7 @@ void HdrDpxImageElement::ReadRow(uint32_t row)
 			}
 			else   // Packed
 			{
-				int_datum = fifo.GetDatum(bpc, is_signed, m_direction_r2l);
+				int_datum = fifo.GetDatum(bpc, is_signed, m_layout.direction_r2l);
 			}
 			break;
 		case 32:
@@ -814,21 +655,24 @@ void HdrDpxImageElement::ReadRow(uint32_t row)
 			else if (component == num_components - 1)
 			{
 				m_int_row[row_wr_idx++] = int_datum;
-				rle_pixel[component] = int_datum;
 				if (rle_is_same)
 				{
-					if (xpos + run_length > m_width && !m_warn_rle_same_past_eol)
+					if (xpos + run_length > m_layout.width && !m_warn_rle_same_past_eol)
 					{
 						m_warn_rle_same_past_eol = true;
 						m_warnings.push_back("RLE same-pixel run went past the end of a line, first occurred at " + std::to_string(xpos) + ", " + std::to_string(row));
 					}
-					for (int i = 1; i < run_length; ++i)
+					// Replicate the pixel just decoded by doubling the copied block (never past the end of the row buffer)
+					const size_t pixel_datums = static_cast<size_t>(num_components);
+					const size_t run_datums = std::min(static_cast<uint32_t>(MAX(1, run_length)), m_layout.width - xpos) * pixel_datums;
+					int32_t *run_start = m_int_row + row_wr_idx - pixel_datums;
+					for (size_t filled = pixel_datums; filled < run_datums; )
 					{
-						for (int c = 0; c < num_components; ++c)
-						{
-							m_int_row[row_wr_idx++] = rle_pixel[c];
-						}
+						size_t copy = std::min(filled, run_datums - filled);
+						memcpy(run_start + filled, run_start, copy * sizeof(int32_t));
+						filled += copy;
 					}
+					row_wr_idx += static_cast<uint32_t>(run_datums - pixel_datums);
 					component = 0;
 					xpos += MAX(1, run_length);
 					rle_state = 0;
@@ -842,7 +686,7 @@ void HdrDpxImageElement::ReadRow(uint32_t row)
 						rle_state = 0;
 					else
 					{
-						if (xpos >= m_width && !m_warn_rle_diff_past_eol)
+						if (xpos >= m_layout.width && !m_warn_rle_diff_past_eol)
 						{
 							m_warn_rle_diff_past_eol = true;
 							m_warnings.push_back("RLE different-pixel run went past the end of a line, first occurred at " + std::to_string(xpos) + ", " + std::to_string(row));
@@ -853,7 +697,6 @@ void HdrDpxImageElement::ReadRow(uint32_t row)
 			else
 			{
 				m_int_row[row_wr_idx++] = int_datum;
-				rle_pixel[component] = int_datum;
 				component++;
 			}
 		}
@@ -868,59 +711,69 @@ void HdrDpxImageElement::ReadRow(uint32_t row)
 				xpos++;
 			}
 		}
-		if (xpos > m_width)
+		if (xpos > m_layout.width)
 		{
 			LOG_ERROR(eBadParameter, eFatal, "RLE decode went past the end of line\n");
 			return;
 		}
 	}
 
+	if (m_filestream_ptr->eof())    // read-ahead for the last row of the file can go past the end of the file
+		m_filestream_ptr->clear();
 	m_previous_file_offset = static_cast<uint32_t>(m_filestream_ptr->tellg()) - 4 * (fifo.m_fullness >> 5);
+	if (m_dpx_ie_ptr->Encoding == 1 && row + 1 < m_rle_row_offsets.size())
+		m_rle_row_offsets[row + 1] = m_previous_file_offset;
 }
 
 
 
-void HdrDpxImageElement::WriteFlush()
+void HdrDpxImageElement::WriteFlush(RowEncoder &enc) const
 {
 	uint32_t image_data_word;
 
-	while (m_fifo.m_fullness >= 32)
+	while (enc.fifo.m_fullness >= 32)
 	{
-		image_data_word = m_fifo.GetBitsUi(32);
+		image_data_word = enc.fifo.GetBitsUi(32);
 		if (m_byte_swap)
 			ByteSwap32((void *)(&image_data_word));
-		m_filestream_ptr->write((char *)(&image_data_word), 4);
+		if (enc.out != NULL)
+		{
+			memcpy(enc.out, &image_data_word, 4);
+			enc.out += 4;
+		}
+		else
+			enc.words.push_back(image_data_word);
 	}
 }
 
 
-void HdrDpxImageElement::WriteDatum(int32_t datum)
+void HdrDpxImageElement::WriteDatum(RowEncoder &enc, int32_t datum) const
 {
 	const uint8_t bpc = m_dpx_ie_ptr->BitSize;
 	switch (m_dpx_ie_ptr->Packing)
 	{
 	case 0:
-		m_fifo.PutDatum(datum, bpc, m_direction_r2l);
+		enc.fifo.PutDatum(datum, bpc, m_layout.direction_r2l);
 		break;
 	case 1:  /* Method A */
-		if (m_direction_r2l && (m_fifo.m_fullness == 0 || m_fifo.m_fullness == 16))
-			m_fifo.FlipPutBits(0, (bpc == 10) ? 2 : 4);
-		m_fifo.PutDatum(datum, bpc, m_direction_r2l);
-		if (!m_direction_r2l && (m_fifo.m_fullness == 12 || m_fifo.m_fullness == 28 || m_fifo.m_fullness == 30))
-			m_fifo.PutBits(0, (bpc == 10) ? 2 : 4);
+		if (m_layout.direction_r2l && (enc.fifo.m_fullness == 0 || enc.fifo.m_fullness == 16))
+			enc.fifo.FlipPutBits(0, (bpc == 10) ? 2 : 4);
+		enc.fifo.PutDatum(datum, bpc, m_layout.direction_r2l);
+		if (!m_layout.direction_r2l && (enc.fifo.m_fullness == 12 || enc.fifo.m_fullness == 28 || enc.fifo.m_fullness == 30))
+			enc.fifo.PutBits(0, (bpc == 10) ? 2 : 4);
 		break;  /* Method B */
 	case 2:
-		if (!m_direction_r2l && (m_fifo.m_fullness == 0 || m_fifo.m_fullness == 16))
-			m_fifo.PutBits(0, (bpc == 10) ? 2 : 4);
-		m_fifo.PutDatum(datum, bpc, m_direction_r2l);
-		if (m_direction_r2l && (m_fifo.m_fullness == 12 || m_fifo.m_fullness == 28 || m_fifo.m_fullness == 30))
-			m_fifo.FlipPutBits(0, (bpc == 10) ? 2 : 4);
+		if (!m_layout.direction_r2l && (enc.fifo.m_fullness == 0 || enc.fifo.m_fullness == 16))
+			enc.fifo.PutBits(0, (bpc == 10) ? 2 : 4);
+		enc.fifo.PutDatum(datum, bpc, m_layout.direction_r2l);
+		if (m_layout.direction_r2l && (enc.fifo.m_fullness == 12 || enc.fifo.m_fullness == 28 || enc.fifo.m_fullness == 30))
+			enc.fifo.FlipPutBits(0, (bpc == 10) ? 2 : 4);
 		break;
 	}
-	WriteFlush();
+	WriteFlush(enc);
 }
 
-void HdrDpxImageElement::WritePixel(uint32_t xpos)
+void HdrDpxImageElement::WritePixel(RowEncoder &enc, uint32_t xpos) const
 {
 	int component;
 	int num_components;
@@ -934,7 +787,7 @@ void HdrDpxImageElement::WritePixel(uint32_t xpos)
 	} c_r32;
 	int32_t int_datum;
 
-	num_components = GetNumberOfComponents();
+	num_components = m_layout.num_components;
 
 	for (component = 0; component < num_components; ++component)
 	{
@@ -945,46 +798,69 @@ void HdrDpxImageElement::WritePixel(uint32_t xpos)
 		case 10:
 		case 12:
 		case 16:
-			int_datum = m_int_row[xpos * num_components + component];
-			WriteDatum(int_datum);
+			int_datum = enc.int_row[xpos * num_components + component];
+			WriteDatum(enc, int_datum);
 			break;
 		case 32:
-			c_r32.r32 = m_float_row[xpos * num_components + component];
-			m_fifo.PutBits(c_r32.d, 32);
-			WriteFlush();
+			c_r32.r32 = enc.float_row[xpos * num_components + component];
+			enc.fifo.PutBits(c_r32.d, 32);
+			WriteFlush(enc);
 			break;
 		case 64:
-			c_r64.r64 = m_double_row[xpos * num_components + component];
-			m_fifo.PutBits(c_r64.d[0], 32);
-			m_fifo.PutBits(c_r64.d[1], 32);
-			WriteFlush();
+			c_r64.r64 = enc.double_row[xpos * num_components + component];
+			enc.fifo.PutBits(c_r64.d[0], 32);
+			enc.fifo.PutBits(c_r64.d[1], 32);
+			WriteFlush(enc);
 			break;
 		}
 
 	}
 }
 
-bool HdrDpxImageElement::IsNextSame(uint32_t xpos, int32_t pixel[])
+uint32_t HdrDpxImageElement::ScanRun(const RowEncoder &enc, uint32_t xpos, bool &same) const
 {
-	int num_components;
+	const uint32_t num_components = m_layout.num_components;
+	const size_t pixel_bytes = num_components * sizeof(int32_t);
+	const unsigned int max_run = (1 << (m_dpx_ie_ptr->BitSize - 1)) - 1;
+	const int32_t *row = enc.int_row;
+	uint32_t run_length = 1;
 
-	if (xpos >= m_width - 1)
-		return false;
-	num_components = GetNumberOfComponents();
+	// Whether pixel x matches pixel x + 1 (the last pixel of the line has no successor)
+	auto same_as_next = [&](uint32_t x) {
+		return x < m_layout.width - 1 && memcmp(row + x * num_components, row + (x + 1) * num_components, pixel_bytes) == 0;
+	};
+
+	if (num_components > 1)
+		same = same_as_next(xpos);
+	else  // For 1-component IEs, it doesn't make sense to declare a run unleses it lasts more than 2 pixels
+		same = same_as_next(xpos) && same_as_next(xpos + 1);
 
-	for (int c = 0; c < num_components; ++c)
+	if (same)
 	{
-		if (pixel[c] != m_int_row[(xpos + 1) * num_components + c])
-			return false;
+		while (run_length < m_layout.width - xpos && run_length < max_run - 1 && same_as_next(xpos + run_length))
+			run_length++;
 	}
-	return true;
+	else
+	{
+		// A different run ends just before the first pixel that starts a same run
+		while (run_length < m_layout.width - xpos - 1 && run_length < max_run - 1)
+		{
+			if (same_as_next(xpos + run_length))
+			{
+				run_length--;
+				break;
+			}
+			run_length++;
+		}
+	}
+	return run_length + 1;
 }
 
-void HdrDpxImageElement::WriteLineEnd()
+void HdrDpxImageElement::WriteLineEnd(RowEncoder &enc) const
 {
-	if (m_fifo.m_fullness & 0x1f)   // not an even multiple of 32 
-		m_fifo.PutDatum(0, 32 - (m_fifo.m_fullness & 0x1f), m_direction_r2l);
-	WriteFlush();
+	if (enc.fifo.m_fullness & 0x1f)   // not an even multiple of 32 
+		enc.fifo.PutDatum(0, 32 - (enc.fifo.m_fullness & 0x1f), m_layout.direction_r2l);
+	WriteFlush(enc);
 }
 
 
@@ -1061,17 +937,189 @@ void HdrDpxImageElement::App2DpxPixels(uint32_t row, double *datum_ptr)
 }
 
 void HdrDpxImageElement::WriteRow(uint32_t row)
+{
+	m_row_encoder.int_row = m_int_row;
+	m_row_encoder.float_row = m_float_row;
+	m_row_encoder.double_row = m_double_row;
+	if (IsWrittenToMapping())
+	{
+		// Pack the row straight into the output file
+		if (row >= m_layout.height)
+		{
+			LOG_ERROR(eBadParameter, eFatal, "Row number is past the end of the image element");
+			return;
+		}
+		m_row_encoder.out = m_mapped_data + GetOffsetForRow(row);
+		EncodeRow(m_row_encoder);
+		m_row_encoder.out = NULL;
+		return;
+	}
+	EncodeRow(m_row_encoder);
+	WriteEncodedRow(row, m_row_encoder.words);
+}
+
+bool HdrDpxImageElement::IsWrittenToMapping(void) const
+{
+	return m_mapped_data != NULL && m_dpx_ie_ptr->Encoding != 1;
+}
+
+
+void HdrDpxImageElement::EncodeRow(RowEncoder &enc) const
 {
 	uint32_t xpos;
-	int component;
-	int num_components;
 	uint32_t run_length = 0;
-	unsigned int max_run;
 	bool run_type;
-	int32_t rle_pixel[8];
 	const uint8_t bpc = m_dpx_ie_ptr->BitSize;
 
-	m_fifo.Clear();
+	enc.fifo.Clear();
+	enc.words.clear();
+
+	if (m_dpx_ie_ptr->Encoding == 1 && bpc > 1 && bpc <= 16 && m_optimal_rle)
+	{
+		EncodeRowOptimalRLE(enc);
+		WriteLineEnd(enc);
+		return;
+	}
+
+	xpos = 0;
+	while (xpos < m_layout.width)
+	{
+		if (m_dpx_ie_ptr->Encoding == 1 && bpc <= 16) // RLE
+		{
+			if (xpos == m_layout.width - 1)  // Only one pixel left on line
+			{
+				WriteDatum(enc, 2);  // Indicates run of 1 pixel
+				WritePixel(enc, xpos);
+				xpos++;
+			}
+			else {
+				run_length = ScanRun(enc, xpos, run_type);
+				if (run_type)
+				{
+					WriteDatum(enc, 1 | (run_length << 1));
+					WritePixel(enc, xpos);
+					xpos += run_length;
+					if (xpos > m_layout.width)
+						std::cout << "Something went wrong";
+				}
+				else
+				{
+					WriteDatum(enc, 0 | (run_length << 1));
+					while (run_length--)
+					{
+						WritePixel(enc, xpos);
+						xpos++;
+						if (xpos > m_layout.width)
+							std::cout << "Something went wrong";
+					}
+				}
+			}
+		}
+		else  // non-RLE (uncompressed)
+		{
+			for (run_length = 0; run_length < m_layout.width; ++run_length)
+			{
+				WritePixel(enc, xpos);
+				xpos++;
+				if (xpos > m_layout.width)
+					std::cout << "Something went wrong";
+			}
+		}
+
+		if (xpos >= m_layout.width)
+		{
+			// pad last line
+			WriteLineEnd(enc);
+		}
+	}
+}
+
+
+void HdrDpxImageElement::EncodeRowOptimalRLE(RowEncoder &enc) const
+{
+	const uint32_t num_components = m_layout.num_components;
+	const size_t pixel_bytes = num_components * sizeof(int32_t);
+	const uint32_t max_run = (1u << (m_dpx_ie_ptr->BitSize - 1)) - 1;
+	const int32_t *row = enc.int_row;
+	std::vector<uint32_t> &cost = enc.run_cost;
+	std::vector<uint32_t> &choice = enc.run_choice;
+	std::vector<uint32_t> &window = enc.run_window;
+	uint32_t head = 0, tail = 0;
+	uint32_t same_length = 0;
+	uint32_t xpos;
+
+	// Minimizing the number of datums also minimizes the row size for every packing, since datums are packed in order.
+	// cost[x] is the fewest datums needed to encode pixels x to the end of the line. Because cost never increases with x,
+	// a same run is always taken as long as possible, and the best different run is found with a sliding window minimum.
+	cost.resize(m_layout.width + 1);
+	choice.resize(m_layout.width + 1);
+	window.resize(m_layout.width + 1);
+	cost[m_layout.width] = 0;
+	for (xpos = m_layout.width; xpos-- > 0; )
+	{
+		if (xpos + 1 < m_layout.width && memcmp(row + xpos * num_components, row + (xpos + 1) * num_components, pixel_bytes) == 0)
+			same_length++;
+		else
+			same_length = 1;
+
+		// A different run ending at y costs 1 + (y - xpos) * num_components + cost[y]
+		const uint32_t end = xpos + 1;
+		while (tail > head && window[tail - 1] * num_components + cost[window[tail - 1]] >= end * num_components + cost[end])
+			tail--;
+		window[tail++] = end;
+		while (window[head] - xpos > max_run)
+			head++;
+		uint32_t best_end = window[head];
+		cost[xpos] = 1 + (best_end - xpos) * num_components + cost[best_end];
+		choice[xpos] = (best_end - xpos) << 1;
+
+		if (same_length >= 2)
+		{
+			uint32_t run_length = std::min(same_length, max_run);
+			if (1 + num_components + cost[xpos + run_length] <= cost[xpos])
+			{
+				cost[xpos] = 1 + num_components + cost[xpos + run_length];
+				choice[xpos] = (run_length << 1) | 1;
+			}
+		}
+	}
+
+	for (xpos = 0; xpos < m_layout.width; )
+	{
+		uint32_t run_length = choice[xpos] >> 1;
+		WriteDatum(enc, static_cast<int32_t>(choice[xpos]));
+		if (choice[xpos] & 1)
+			WritePixel(enc, xpos);
+		else
+		{
+			for (uint32_t i = 0; i < run_length; ++i)
+				WritePixel(enc, xpos + i);
+		}
+		xpos += run_length;
+	}
+}
+
+
+void HdrDpxImageElement::WriteEndOfImagePadding()
+{
+	uint32_t padding = 0;
+	for (uint32_t b = 0; b < m_dpx_ie_ptr->EndOfImagePadding; ++b)
+		m_filestream_ptr->write((char *)(&padding), 4);
+}
+
+void HdrDpxImageElement::WriteEncodedRow(uint32_t row, const std::vector<uint32_t> &words)
+{
+	if (m_dpx_ie_ptr->Encoding == 1 && m_buffer_rle_rows)
+	{
+		// Rows are laid out in the file when it is closed, so any row order is fine
+		if (row >= m_rle_row_buffers.size())
+		{
+			LOG_ERROR(eBadParameter, eFatal, "Row number is past the end of the image element");
+			return;
+		}
+		m_rle_row_buffers[row] = words;
+		return;
+	}
 
 	if (m_dpx_ie_ptr->Encoding == 1)
 	{
@@ -1081,10 +1129,13 @@ void HdrDpxImageElement::WriteRow(uint32_t row)
 		}
 	}
 
-	num_components = GetNumberOfComponents();
-
 	if (m_dpx_ie_ptr->Encoding == 1)  // RLE
 	{
+		if (row >= m_rle_row_offsets.size())
+		{
+			LOG_ERROR(eBadParameter, eFatal, "Row number is past the end of the image element");
+			return;
+		}
 		if (row == 0)
 		{
 			uint32_t data_offset = m_dpx_ie_ptr->DataOffset;
@@ -1100,6 +1151,7 @@ void HdrDpxImageElement::WriteRow(uint32_t row)
 				m_dpx_ie_ptr->DataOffset = data_offset;
 			}
 			m_filestream_ptr->seekp(data_offset);
+			m_rle_row_offsets[row] = data_offset;
 		}
 		else if (row != m_previous_row + 1)
 		{
@@ -1107,113 +1159,173 @@ void HdrDpxImageElement::WriteRow(uint32_t row)
 			return;
 		}
 		else
+		{
 			m_filestream_ptr->seekp(m_previous_file_offset);
+			m_rle_row_offsets[row] = m_previous_file_offset;
+		}
 		m_previous_row = row;
 	}
 	else
 		m_filestream_ptr->seekp(GetOffsetForRow(row));
 
-	max_run = (1 << (bpc - 1)) - 1;
-
-	xpos = 0;
+	m_filestream_ptr->write((const char *)words.data(), words.size() * 4);
 
-	// write
-	m_row_rd_idx = 0;
-	xpos = 0;
-	while (xpos < m_width)
+	m_previous_file_offset = static_cast<uint32_t>(m_filestream_ptr->tellp());
+	if (row == m_layout.height - 1)
 	{
-		if (m_dpx_ie_ptr->Encoding == 1 && bpc <= 16) // RLE
-		{
-			if (xpos == m_width - 1)  // Only one pixel left on line
-			{
-				WriteDatum(2);  // Indicates run of 1 pixel
-				WritePixel(xpos);
-				xpos++;
-			}
-			else {
-				for (component = 0; component < num_components; ++component)
-				{
-					rle_pixel[component] = m_int_row[xpos * num_components + component];
-				}
-				if (num_components > 1)
-					run_type = IsNextSame(xpos, rle_pixel);
-				else  // For 1-component IEs, it doesn't make sense to declare a run unleses it lasts more than 2 pixels
-					run_type = IsNextSame(xpos, rle_pixel) && IsNextSame(xpos + 1, rle_pixel); 
-				if (run_type)  //  Same run
-				{
-					for (run_length = 1; run_length < m_width - xpos && run_length < max_run - 1; ++run_length)
-					{
-						if (IsNextSame(xpos + run_length, rle_pixel) != run_type)
-							break;
-					}
-				}
-				else   // Different run
-				{
-					for (run_length = 1; run_length < m_width - xpos - 1 && run_length < max_run - 1; ++run_length)
-					{
-						for (component = 0; component < num_components; ++component)
-						{
-							rle_pixel[component] = m_int_row[(xpos + run_length) * num_components + component];
-						}
-						if (IsNextSame(xpos + run_length, rle_pixel) != run_type)
-						{
-							run_length--;
-							break;
-						}
-					}
-				}
-				run_length++;
-				if (run_type)
-				{
-					WriteDatum(1 | (run_length << 1));
-					WritePixel(xpos);
-					xpos += run_length;
-					if (xpos > m_width)
-						std::cout << "Something went wrong";
-				}
-				else
-				{
-					WriteDatum(0 | (run_length << 1));
-					while (run_length--)
-					{
-						WritePixel(xpos);
-						xpos++;
-						if (xpos > m_width)
-							std::cout << "Something went wrong";
-					}
-				}
-			}
-		}
-		else  // non-RLE (uncompressed)
+		WriteEndOfImagePadding();
+		if (m_dpx_ie_ptr->Encoding == 1)
 		{
-			for (run_length = 0; run_length < m_width; ++run_length)
-			{
-				WritePixel(xpos);
-				xpos++;
-				if (xpos > m_width)
-					std::cout << "Something went wrong";
-			}
-		}
+			m_file_map_ptr->EditRegionEnd(m_ie_index, static_cast<uint32_t>(m_filestream_ptr->tellp()));
 
-		if (xpos >= m_width)
-		{
-			// pad last line
-			WriteLineEnd();
+			m_file_map_ptr->AdvanceRLEIE();
 		}
 	}
+}
+
+
+uint32_t HdrDpxImageElement::GetBufferedRLESize() const
+{
+	uint64_t size = static_cast<uint64_t>(m_dpx_ie_ptr->EndOfImagePadding) * 4;
+	for (const auto &words : m_rle_row_buffers)
+		size += words.size() * 4;
+	if (size > UINT32_MAX)
+		return UINT32_MAX;
+	return static_cast<uint32_t>(size);
+}
+
+
+void HdrDpxImageElement::WriteBufferedRLERows()
+{
+	bool missing_rows = false;
+
+	m_filestream_ptr->seekp(m_dpx_ie_ptr->DataOffset);
+	for (uint32_t row = 0; row < m_rle_row_buffers.size(); ++row)
+	{
+		const std::vector<uint32_t> &words = m_rle_row_buffers[row];
+		if (words.empty())
+			missing_rows = true;
+		m_rle_row_offsets[row] = static_cast<uint32_t>(m_filestream_ptr->tellp());
+		m_filestream_ptr->write((const char *)words.data(), words.size() * 4);
+	}
+	WriteEndOfImagePadding();
 	m_previous_file_offset = static_cast<uint32_t>(m_filestream_ptr->tellp());
-	if (row == m_height - 1)
+	if (missing_rows)
+		LOG_ERROR(eFileWriteError, eWarning, "Not all rows of image element " + std::to_string(m_ie_index + 1) + " were written");
+
+	m_rle_row_buffers.clear();
+	m_rle_row_buffers.shrink_to_fit();
+}
+
+
+void HdrDpxImageElement::App2DpxPixelRows(uint32_t first_row, uint32_t num_rows, int32_t *datum_ptr, unsigned int num_threads)
+{
+	// There is no check on whether the d pointer is valid or the size of d, that is the responsiblility of the caller
+	if (!m_isinitialized)
 	{
-		uint32_t padding = 0;
-		for (uint32_t b = 0; b < m_dpx_ie_ptr->EndOfImagePadding; ++b)
-			m_filestream_ptr->write((char *)(&padding), 4);
-		if (m_dpx_ie_ptr->Encoding == 1)
-		{
-			m_file_map_ptr->EditRegionEnd(m_ie_index, static_cast<uint32_t>(m_filestream_ptr->tellp()));
+		LOG_ERROR(eBadParameter, eFatal, "Tried to write pixels to uninitialized image element");
+		return;
+	}
+	if (!m_is_open_for_write || !m_filestream_ptr->good())
+	{
+		LOG_ERROR(eFileWriteError, eFatal, "File write error");
+		return;
+	}
+	if (m_dpx_ie_ptr->BitSize >= 32)
+	{
+		LOG_ERROR(eBadParameter, eFatal, "Failed attempt writing integer pixels to floating point file");
+		return;
+	}
+	if (first_row + num_rows > m_layout.height || first_row + num_rows < first_row)
+	{
+		LOG_ERROR(eBadParameter, eFatal, "Row range is past the end of the image element");
+		return;
+	}
 
-			m_file_map_ptr->AdvanceRLEIE();
+	const uint32_t datums_per_row = GetRowSizeInDatums();
+	std::vector<RowEncoder> encoders(num_rows);
+	std::vector<std::thread> workers;
+
+	if (num_threads == 0)
+		num_threads = std::thread::hardware_concurrency();
+	if (num_threads > num_rows)
+		num_threads = num_rows;
+	if (num_threads == 0)
+		num_threads = 1;
+
+	// Each row is encoded into its own buffer (or its own place in a mapped file), so rows can be compressed independently of each other
+	for (uint32_t r = 0; r < num_rows; ++r)
+	{
+		encoders[r].int_row = datum_ptr + static_cast<size_t>(r) * datums_per_row;
+		if (IsWrittenToMapping())
+			encoders[r].out = m_mapped_data + GetOffsetForRow(first_row + r);
+	}
+	for (unsigned int t = 1; t < num_threads; ++t)
+	{
+		workers.push_back(std::thread([this, &encoders, t, num_threads]() {
+			for (size_t r = t; r < encoders.size(); r += num_threads)
+				EncodeRow(encoders[r]);
+		}));
+	}
+	for (size_t r = 0; r < encoders.size(); r += num_threads)
+		EncodeRow(encoders[r]);
+	for (auto &w : workers)
+		w.join();
+
+	// The buffers are written in row order, which fixes up the RLE row offsets and the file map as for WriteRow()
+	if (IsWrittenToMapping())
+		return;
+	for (uint32_t r = 0; r < num_rows; ++r)
+		WriteEncodedRow(first_row + r, encoders[r].words);
+}
+
+
+void HdrDpxImageElement::AddEncodingSampleRow(const int32_t *datum_ptr)
+{
+	if (m_is_header_locked)
+	{
+		LOG_ERROR(eHeaderLocked, eWarning, "Encoding sample rows must be provided before the file is opened for writing");
+		return;
+	}
+	ComputeLayout();
+	m_encoding_samples.insert(m_encoding_samples.end(), datum_ptr, datum_ptr + GetRowSizeInDatums());
+	m_num_encoding_samples++;
+}
+
+
+void HdrDpxImageElement::ChooseEncoding(void)
+{
+	RowEncoder enc;
+	uint64_t rle_bytes = 0, uncompressed_bytes = 0;
+	uint32_t datums_per_row;
+
+	ComputeLayout();
+	datums_per_row = GetRowSizeInDatums();
+	m_byte_swap = false;
+	if (m_dpx_ie_ptr->BitSize > 16 || m_num_encoding_samples == 0 || datums_per_row == 0 ||
+		m_encoding_samples.size() != static_cast<size_t>(m_num_encoding_samples) * datums_per_row)
+	{
+		if (m_dpx_ie_ptr->BitSize <= 16)
+			LOG_ERROR(eBadParameter, eWarning, "No usable encoding sample rows for image element " + std::to_string(m_ie_index + 1) + ", writing it uncompressed");
+		m_dpx_ie_ptr->Encoding = eEncodingNoEncoding;
+	}
+	else
+	{
+		// RLE code the samples exactly as the rows will be written
+		m_dpx_ie_ptr->Encoding = eEncodingRLE;
+		for (uint32_t r = 0; r < m_num_encoding_samples; ++r)
+		{
+			enc.int_row = m_encoding_samples.data() + static_cast<size_t>(r) * datums_per_row;
+			EncodeRow(enc);
+			rle_bytes += enc.words.size() * 4;
+			uncompressed_bytes += GetRowSizeInBytes(false);
 		}
+		if (rle_bytes > RLE_AUTO_MAX_RATIO * uncompressed_bytes)
+			m_dpx_ie_ptr->Encoding = eEncodingNoEncoding;
 	}
+	m_encoding_samples.clear();
+	m_encoding_samples.shrink_to_fit();
+	m_num_encoding_samples = 0;
 }
 
 
@@ -1297,6 +1409,8 @@ void HdrDpxImageElement::SetHeader(HdrDpxFieldsDescriptor field, HdrDpxDescripto
 		LOG_ERROR(eHeaderLocked, eWarning, "Attempted to change locked header field");
 		return;
 	}
+	if (RefuseLayoutChange())
+		return;
 	m_dpx_ie_ptr->Descriptor = static_cast<uint8_t>(value);
 }
 
@@ -1342,6 +1456,8 @@ void HdrDpxImageElement::SetHeader(HdrDpxFieldsBitDepth field, HdrDpxBitDepth va
 		LOG_ERROR(eHeaderLocked, eWarning, "Attempted to change locked header field");
 		return;
 	}
+	if (RefuseLayoutChange())
+		return;
 	if ((m_dpx_ie_ptr->BitSize <= 16 && (value == 32 || value == 64)) ||
 		((m_dpx_ie_ptr->BitSize == 32 || m_dpx_ie_ptr->BitSize==64) && value<=16))
 	{
@@ -1365,6 +1481,8 @@ void HdrDpxImageElement::SetHeader(HdrDpxFieldsPacking field, HdrDpxPacking valu
 		LOG_ERROR(eHeaderLocked, eWarning, "Attempted to change locked header field");
 		return;
 	}
+	if (RefuseLayoutChange())
+		return;
 	m_dpx_ie_ptr->Packing = static_cast<uint16_t>(value);
 }
 
@@ -1380,6 +1498,8 @@ void HdrDpxImageElement::SetHeader(HdrDpxFieldsEncoding field, HdrDpxEncoding va
 		LOG_ERROR(eHeaderLocked, eWarning, "Attempted to change locked header field");
 		return;
 	}
+	if (RefuseLayoutChange())
+		return;
 	m_dpx_ie_ptr->Encoding = static_cast<uint16_t>(value);
 }
 
@@ -1395,6 +1515,8 @@ void HdrDpxImageElement::SetHeader(HdrDpxIEFieldsU32 field, uint32_t value)
 		LOG_ERROR(eHeaderLocked, eWarning, "Attempted to change locked header field");
 		return;
 	}
+	if (RefuseLayoutChange())
+		return;
 	switch (field)
 	{
 	case eOffsetToData:
@@ -1467,12 +1589,12 @@ std::string HdrDpxImageElement::GetHeader(HdrDpxIEFieldsString field) const
 
 uint32_t HdrDpxImageElement::GetWidth(void) const
 {
-	return m_width;
+	return m_layout.width;
 }
 
 uint32_t HdrDpxImageElement::GetHeight(void) const
 {
-	return m_height;
+	return m_layout.height;
 }
 
 uint32_t HdrDpxImageElement::BytesUsed(void)
@@ -1480,12 +1602,12 @@ uint32_t HdrDpxImageElement::BytesUsed(void)
 	if (m_dpx_ie_ptr->Encoding == 1)
 		return static_cast<uint32_t>(m_filestream_ptr->tellp()) - m_dpx_ie_ptr->DataOffset + m_dpx_ie_ptr->EndOfImagePadding;
 	else
-		return(GetRowSizeInBytes(true) * m_height + m_dpx_ie_ptr->EndOfImagePadding);
+		return(GetRowSizeInBytes(true) * m_layout.height + m_dpx_ie_ptr->EndOfImagePadding);
 }
 
 uint32_t HdrDpxImageElement::GetImageDataSizeInBytes(void) const
 {
-	return(GetRowSizeInBytes(true) * m_height + m_dpx_ie_ptr->EndOfImagePadding);
+	return(GetRowSizeInBytes(true) * m_layout.height + m_dpx_ie_ptr->EndOfImagePadding);
 }
 
 void HdrDpxImageElement::CopyHeaderFrom(HdrDpxImageElement *ie)